@@ -5,29 +5,126 @@
 // (some of the code borrowed from https://github.com/wesm/bitmaps-vs-sentinels,
 //  licensed MIT)
 //------------------------------------------------------------------------------
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cmath>
+#include <condition_variable>
+#include <cstring>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <random>
-#include <getopt.h>  // option
-#include <unistd.h>  // getopt_long
-#include <stdlib.h>  // atol
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdexcept>
+#include <getopt.h>    // option
+#include <unistd.h>    // getopt_long, pread
+#include <stdlib.h>    // atol
+#include <fcntl.h>     // open
+#include <sys/mman.h>  // mmap, madvise
+#include <sys/stat.h>  // fstat
 #include <omp.h>
+#ifdef __SSE2__
+  #include <emmintrin.h>         // _mm_clflush, _mm_mfence
+#endif
+#ifdef __linux__
+  #include <linux/perf_event.h>  // perf_event_attr
+  #include <sched.h>             // sched_setaffinity, sched_getcpu
+  #include <sys/ioctl.h>         // ioctl
+  #include <sys/syscall.h>       // __NR_perf_event_open, __NR_move_pages
+#endif
 
 using T = int32_t;
 
 
+// How the input buffers are allocated (`--alloc`):
+//   malloc  - plain `malloc()`: 16-byte alignment and 4K pages;
+//   aligned - 64-byte alignment, so that vector loads never straddle cache
+//             lines;
+//   thp     - 2M alignment plus `madvise(MADV_HUGEPAGE)`, asking the kernel
+//             to back the buffer with transparent huge pages;
+//   hugetlb - `mmap(MAP_HUGETLB)` from the preallocated pool of huge pages,
+//             falling back to "thp" when the pool is too small.
+// With `prefault` every page is written to right after the allocation, so
+// that no page faults happen during the first runs of the tasks.
+struct alloc_policy {
+  std::string mode = "malloc";
+  bool prefault = false;
+};
+
+
 struct config {
   size_t seed;
   size_t n;
   double p;
   int nthreads;
+  bool perf;
+  bool sweep;
+  bool cold;
+  std::string bind;
+  bool first_touch;
+  size_t grain;
+  bool scaling;
+  std::string executors;
+  bool reductions;
+  std::string alloc;
+  bool prefault;
+  std::string write_column;
+  std::string read_column;
+  bool populate;
+  std::string advice;
+  std::string stream;
+  size_t batch;
+  std::string arrow;
+  int arrow_column;
+  std::string na_pattern;
+  double na_run;
+  bool crossover;
+  bool roaring;
+  double value_run;
+  int pack_bits;
+  bool aggregates;
+  bool pipeline;
+  size_t morsel;
+  bool filtered;
+  bool autotune;
+  bool accumulators;
 
   config() {
     seed = 1;
     n = 1000000;
     p = 0.1;
     nthreads = 8;
+    perf = false;
+    sweep = false;
+    cold = false;
+    bind = "none";
+    first_touch = false;
+    grain = 16384;
+    scaling = false;
+    executors = "both";
+    reductions = false;
+    alloc = "malloc";
+    prefault = false;
+    populate = false;
+    advice = "normal";
+    batch = 65536;
+    arrow_column = 0;
+    na_pattern = "uniform";
+    na_run = 1000;
+    crossover = false;
+    roaring = false;
+    value_run = 1;
+    pack_bits = 0;
+    aggregates = false;
+    pipeline = false;
+    morsel = 16384;
+    filtered = false;
+    autotune = false;
+    accumulators = false;
   }
 
   void parse(int argc, char** argv) {
@@ -36,6 +133,37 @@ struct config {
       {"n", 1, 0, 0},
       {"p", 1, 0, 0},
       {"nthreads", 1, 0, 0},
+      {"perf", 0, 0, 0},
+      {"sweep", 0, 0, 0},
+      {"cold", 0, 0, 0},
+      {"bind", 1, 0, 0},
+      {"first-touch", 0, 0, 0},
+      {"grain", 1, 0, 0},
+      {"scaling", 0, 0, 0},
+      {"executor", 1, 0, 0},
+      {"reductions", 0, 0, 0},
+      {"alloc", 1, 0, 0},
+      {"prefault", 0, 0, 0},
+      {"write-column", 1, 0, 0},
+      {"read-column", 1, 0, 0},
+      {"populate", 0, 0, 0},
+      {"advice", 1, 0, 0},
+      {"stream", 1, 0, 0},
+      {"batch", 1, 0, 0},
+      {"arrow", 1, 0, 0},
+      {"arrow-column", 1, 0, 0},
+      {"na-pattern", 1, 0, 0},
+      {"na-run", 1, 0, 0},
+      {"crossover", 0, 0, 0},
+      {"roaring", 0, 0, 0},
+      {"value-run", 1, 0, 0},
+      {"pack-bits", 1, 0, 0},
+      {"aggregates", 0, 0, 0},
+      {"pipeline", 0, 0, 0},
+      {"morsel", 1, 0, 0},
+      {"filtered", 0, 0, 0},
+      {"autotune", 0, 0, 0},
+      {"accumulators", 0, 0, 0},
       {nullptr, 0, nullptr, 0}  // sentinel
     };
 
@@ -44,14 +172,123 @@ struct config {
       int ret = getopt_long(argc, argv, "", longopts, &option_index);
       if (ret == -1) break;
       if (ret == 0) {
+        std::string name = longopts[option_index].name;
         if (optarg) {
-          if (option_index == 0) seed = atol(optarg);
-          if (option_index == 1) n = atol(optarg);
-          if (option_index == 2) p = strtod(optarg, nullptr);
-          if (option_index == 3) nthreads = atoi(optarg);
+          if (name == "seed") seed = atol(optarg);
+          if (name == "n") n = atol(optarg);
+          if (name == "p") p = strtod(optarg, nullptr);
+          if (name == "nthreads") nthreads = atoi(optarg);
+          if (name == "bind") {
+            bind = optarg;
+            if (bind != "none" && bind != "compact" && bind != "scatter") {
+              throw std::invalid_argument(
+                  "--bind must be none, compact or scatter");
+            }
+          }
+          if (name == "executor") {
+            executors = optarg;
+            if (executors != "pool" && executors != "omp" &&
+                executors != "both") {
+              throw std::invalid_argument(
+                  "--executor must be pool, omp or both");
+            }
+          }
+          if (name == "alloc") {
+            alloc = optarg;
+            if (alloc != "malloc" && alloc != "aligned" && alloc != "thp" &&
+                alloc != "hugetlb" && alloc != "all") {
+              throw std::invalid_argument(
+                  "--alloc must be malloc, aligned, thp, hugetlb or all");
+            }
+          }
+          if (name == "write-column") write_column = optarg;
+          if (name == "read-column") read_column = optarg;
+          if (name == "advice") {
+            advice = optarg;
+            if (advice != "normal" && advice != "sequential" &&
+                advice != "random" && advice != "willneed" &&
+                advice != "dontneed") {
+              throw std::invalid_argument(
+                  "--advice must be normal, sequential, random, willneed "
+                  "or dontneed");
+            }
+          }
+          if (name == "stream") stream = optarg;
+          if (name == "batch") {
+            long b = atol(optarg);
+            if (b < 64) {
+              throw std::invalid_argument("--batch must be at least 64");
+            }
+            batch = static_cast<size_t>(b) / 64 * 64;
+          }
+          if (name == "arrow") arrow = optarg;
+          if (name == "arrow-column") arrow_column = atoi(optarg);
+          if (name == "na-pattern") {
+            na_pattern = optarg;
+            if (na_pattern != "uniform" && na_pattern != "clustered") {
+              throw std::invalid_argument(
+                  "--na-pattern must be uniform or clustered");
+            }
+          }
+          if (name == "na-run") na_run = strtod(optarg, nullptr);
+          if (name == "value-run") value_run = strtod(optarg, nullptr);
+          if (name == "pack-bits") {
+            pack_bits = atoi(optarg);
+            if (pack_bits < 1 || pack_bits > 32) {
+              throw std::invalid_argument("--pack-bits must be from 1 to 32");
+            }
+          }
+          if (name == "grain") {
+            long g = atol(optarg);
+            if (g < 64) {
+              throw std::invalid_argument("--grain must be at least 64");
+            }
+            grain = (static_cast<size_t>(g) + 63) / 64 * 64;
+          }
+          if (name == "morsel") {
+            // also the grain of the parallel pipelines
+            long m = atol(optarg);
+            if (m < 64) {
+              throw std::invalid_argument("--morsel must be at least 64");
+            }
+            morsel = (static_cast<size_t>(m) + 63) / 64 * 64;
+          }
+        } else {
+          if (name == "perf") perf = true;
+          if (name == "sweep") sweep = true;
+          if (name == "cold") cold = true;
+          if (name == "first-touch") first_touch = true;
+          if (name == "scaling") scaling = true;
+          if (name == "reductions") reductions = true;
+          if (name == "prefault") prefault = true;
+          if (name == "populate") populate = true;
+          if (name == "crossover") crossover = true;
+          if (name == "roaring") roaring = true;
+          if (name == "aggregates") aggregates = true;
+          if (name == "pipeline") pipeline = true;
+          if (name == "filtered") filtered = true;
+          if (name == "autotune") autotune = true;
+          if (name == "accumulators") accumulators = true;
         }
       }
     }
+    // `--alloc all` generates its own inputs and runs the default methods,
+    // so it cannot be combined with the other modes or input sources.
+    if (alloc == "all" &&
+        (reductions || crossover || roaring || sweep || scaling ||
+         aggregates || pipeline || filtered || autotune || accumulators ||
+         !stream.empty() || !arrow.empty() || !read_column.empty() ||
+         !write_column.empty())) {
+      throw std::invalid_argument(
+          "--alloc all cannot be combined with other modes or input files");
+    }
+  }
+
+  alloc_policy allocation() const {
+    alloc_policy policy;
+    policy.mode = alloc;
+    policy.prefault = prefault;
+    return policy;
   }
 
   void report() {
@@ -59,342 +296,6169 @@ struct config {
     printf("  seed     = %zu\n", seed);
     printf("  n        = %zu\n", n);
     printf("  p        = %f\n", p);
+    if (value_run > 1) printf("  value run = %g\n", value_run);
+    if (pack_bits) printf("  pack bits = %d\n", pack_bits);
+    if (na_pattern == "clustered") {
+      printf("  pattern  = clustered (mean NA run %g)\n", na_run);
+    } else {
+      printf("  pattern  = %s\n", na_pattern.c_str());
+    }
     printf("  nthreads = %d\n", nthreads);
+    printf("  perf     = %s\n", perf? "yes" : "no");
+    printf("  sweep    = %s\n", sweep? "yes" : "no");
+    printf("  cold     = %s\n", cold? "yes" : "no");
+    printf("  bind     = %s\n", bind.c_str());
+    printf("  touch    = %s\n", first_touch? "parallel" : "serial");
+    printf("  grain    = %zu\n", grain);
+    printf("  scaling  = %s\n", scaling? "yes" : "no");
+    printf("  executor = %s\n", executors.c_str());
+    printf("  reductions = %s\n", reductions? "yes" : "no");
+    printf("  crossover = %s\n", crossover? "yes" : "no");
+    printf("  roaring  = %s\n", roaring? "yes" : "no");
+    printf("  aggregates = %s\n", aggregates? "yes" : "no");
+    printf("  pipeline = %s, morsel = %zu\n", pipeline? "yes" : "no", morsel);
+    printf("  filtered = %s\n", filtered? "yes" : "no");
+    printf("  autotune = %s\n", autotune? "yes" : "no");
+    printf("  accumulators = %s\n", accumulators? "yes" : "no");
+    printf("  alloc    = %s%s\n", alloc.c_str(), prefault? " (prefault)" : "");
+    if (!stream.empty()) {
+      printf("  stream   = %s (batch %zu)\n", stream.c_str(), batch);
+    }
+    if (!arrow.empty()) {
+      printf("  input    = %s (Arrow IPC, column %d)\n", arrow.c_str(),
+             arrow_column);
+    }
+    if (!read_column.empty()) {
+      printf("  input    = %s (mmap%s, advice %s)\n", read_column.c_str(),
+             populate? " + populate" : "", advice.c_str());
+    }
     printf("\n");
   }
 };
 
 
-struct input_data {
-  size_t n;
-  std::vector<T> data;
-  std::vector<uint8_t> namask;
-
-  input_data(size_t _n) : n(_n) {}
+// Uninitialized array of trivially copyable values. Unlike `std::vector`, the
+// memory is not touched when allocated (unless prefaulting is requested), so
+// that the placement of its pages on NUMA nodes is decided by whichever
+// thread writes into them first.
+template <typename V>
+struct buffer {
+  V* ptr;
+  size_t count;
+  size_t mapped;  // size of the region if it was obtained from `mmap()`
+  bool owned;     // false if the buffer is a view into memory owned elsewhere
 
-  void generate(size_t seed) {
-    std::mt19937 rng(seed);
-    std::uniform_int_distribution<T> dist(0, 100);
-    data.resize(n);
-    std::generate(data.begin(), data.end(),
-                  [&]() { return dist(rng); });
-  }
+  buffer() : ptr(nullptr), count(0), mapped(0), owned(true) {}
+  buffer(const buffer&) = delete;
+  buffer& operator=(const buffer&) = delete;
+  ~buffer() { release(); }
 
-  void fill_nas(double p, size_t seed) {
-    // Note: for bitmask array, bit=1 for valid values, and 0 for NA values.
-    constexpr T na_value = std::numeric_limits<T>::min();
-    std::mt19937 rng(seed);
-    std::uniform_real_distribution<double> dist(0, 1);
-    namask.resize((n + 7) / 8, uint8_t(0xFF));
-    for (size_t i = 0; i < n; ++i) {
-      if (dist(rng) < p) {
-        namask[i/8] &= ~uint8_t(1 << (i & 7));
-        data[i] = na_value;
+  void allocate(size_t n, const alloc_policy& policy = alloc_policy()) {
+    constexpr size_t huge_page = size_t(2) << 20;
+    release();
+    size_t bytes = std::max(n * sizeof(V), size_t(1));
+    void* mem = nullptr;
+    #ifdef __linux__
+      if (policy.mode == "hugetlb") {
+        size_t size = (bytes + huge_page - 1) / huge_page * huge_page;
+        mem = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (mem == MAP_FAILED) {
+          mem = nullptr;
+        } else {
+          mapped = size;
+        }
+      }
+    #endif
+    if (!mem) {
+      size_t alignment = policy.mode == "malloc"? 0 :
+                         policy.mode == "aligned"? 64 : huge_page;
+      if (alignment) {
+        if (posix_memalign(&mem, alignment, bytes)) mem = nullptr;
+      } else {
+        mem = malloc(bytes);
       }
+      if (!mem) throw std::bad_alloc();
+      #ifdef MADV_HUGEPAGE
+        if (alignment == huge_page) madvise(mem, bytes, MADV_HUGEPAGE);
+      #endif
+    }
+    ptr = static_cast<V*>(mem);
+    count = n;
+    if (policy.prefault) {
+      volatile char* p = static_cast<char*>(mem);
+      for (size_t i = 0; i < bytes; i += 4096) p[i] = 0;
     }
   }
-};
 
+  // Makes the buffer refer to `n` values at `p`, without taking ownership.
+  void view(const V* p, size_t n) {
+    release();
+    ptr = const_cast<V*>(p);
+    count = n;
+    owned = false;
+  }
 
-struct task {
-  static constexpr int n_iterations = 100;
-  const std::string task_name;
-  int64_t total;
+  void release() {
+    if (owned) {
+      if (mapped) munmap(ptr, mapped);
+      else free(ptr);
+    }
+    ptr = nullptr;
+    count = mapped = 0;
+    owned = true;
+  }
 
-  task(const std::string& name) : task_name(name), total(0) {}
+  V* data() { return ptr; }
+  const V* data() const { return ptr; }
+  size_t size() const { return count; }
+  V* begin() { return ptr; }
+  V* end() { return ptr + count; }
+  V& operator[](size_t i) { return ptr[i]; }
+  const V& operator[](size_t i) const { return ptr[i]; }
+};
 
-  virtual void run_once(const input_data& data) = 0;
 
-  void run(const input_data& data) {
-    std::vector<double> times;
-    for (int i = 0; i < n_iterations; ++i) {
-      auto time0 = std::chrono::high_resolution_clock::now();
-      run_once(data);
-      auto time1 = std::chrono::high_resolution_clock::now();
-      std::chrono::duration<double> diff = time1 - time0;
-      times.push_back(diff.count());  // store the time in seconds
+// Memory mapping of a whole file. `populate` pre-faults the pages
+// (`MAP_POPULATE`, where supported), and `advice` is one of "normal",
+// "sequential", "random", "willneed" or "dontneed", passed to `madvise()`.
+// The mapping is read-only, unless `writable` is set: then it is private, so
+// that writing into a page creates a private copy of only that page, while
+// the file (and the other pages, still shared with the page cache) remain
+// unchanged.
+struct mapped_file {
+  void* addr;
+  size_t size;
+
+  mapped_file(const std::string& path, bool populate,
+              const std::string& advice, bool writable = false)
+    : addr(nullptr), size(0)
+  {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Cannot open file " + path);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+      ::close(fd);
+      throw std::runtime_error("Cannot map empty file " + path);
     }
-    double mean_time = 0.0;
-    for (auto& t : times) mean_time += t;
-    mean_time /= n_iterations;
-    double msd = 0.0;
-    for (auto& t : times) msd += (t - mean_time) * (t - mean_time);
-    msd /= n_iterations - 1;
-    double stdev = std::sqrt(msd);
-    std::cout << task_name << ": ";
-    for (size_t i = task_name.size(); i < 30; ++i) std::cout << ' ';
-    std::cout << mean_time << " s,  +/- " << stdev << " s\n";
+    size = static_cast<size_t>(st.st_size);
+    int flags = writable? MAP_PRIVATE : MAP_SHARED;
+    int prot = writable? PROT_READ | PROT_WRITE : PROT_READ;
+    #ifdef MAP_POPULATE
+      if (populate) flags |= MAP_POPULATE;
+    #else
+      (void) populate;
+    #endif
+    addr = mmap(nullptr, size, prot, flags, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) throw std::runtime_error("Cannot mmap " + path);
+    int adv = advice == "sequential"? MADV_SEQUENTIAL :
+              advice == "random"?     MADV_RANDOM :
+              advice == "willneed"?   MADV_WILLNEED :
+              advice == "dontneed"?   MADV_DONTNEED : MADV_NORMAL;
+    madvise(addr, size, adv);
   }
+
+  mapped_file(const mapped_file&) = delete;
+  mapped_file& operator=(const mapped_file&) = delete;
+  ~mapped_file() { munmap(addr, size); }
+
+  const char* bytes() const { return static_cast<const char*>(addr); }
+  char* bytes() { return static_cast<char*>(addr); }
 };
 
 
-struct sum_ignore_nulls : public task {
-  sum_ignore_nulls() : task("sum_ignore_nulls") {}
+// Binary column file. The file starts with this header; the values (with NAs
+// already replaced by the sentinel) and the validity bitmap follow, each in
+// its own block aligned to `column_alignment` bytes, so that the blocks can
+// be mmapped and scanned directly.
+struct column_header {
+  char     magic[8];       // "NASCOL\0\1"
+  uint32_t version;        // 1
+  uint32_t type;           // 1 = int32
+  uint32_t elem_size;      // sizeof(T)
+  uint32_t na_encoding;    // combination of `column_sentinel`, `column_bitmap`
+  uint64_t n;              // number of elements
+  int64_t  na_value;       // the sentinel value
+  uint64_t values_offset;
+  uint64_t values_size;    // in bytes
+  uint64_t bitmap_offset;
+  uint64_t bitmap_size;    // in bytes
 
-  void run_once(const input_data& data) override {
-    const size_t n = data.n;
-    const T* x = data.data.data();
-    for (size_t i = 0; i < n; ++i) {
-      total += x[i];
-    }
-  }
+  // Loads the header from the first `size` bytes of a file, and verifies
+  // that it describes a column this program can scan.
+  void read(const char* bytes, size_t size, const std::string& path);
 };
+constexpr char column_magic[8] = {'N', 'A', 'S', 'C', 'O', 'L', 0, 1};
+constexpr uint32_t column_sentinel = 1;
+constexpr uint32_t column_bitmap = 2;
+constexpr size_t column_alignment = 4096;
 
+void column_header::read(const char* bytes, size_t size,
+                         const std::string& path) {
+  if (size < sizeof(column_header)) {
+    throw std::runtime_error("File " + path + " is not a column file");
+  }
+  memcpy(this, bytes, sizeof(column_header));
+  if (memcmp(magic, column_magic, sizeof(magic)) != 0) {
+    throw std::runtime_error("File " + path + " is not a column file");
+  }
+  if (version != 1 || type != 1 || elem_size != sizeof(T) ||
+      na_encoding != (column_sentinel | column_bitmap) ||
+      na_value != std::numeric_limits<T>::min()) {
+    throw std::runtime_error("Unsupported column format in " + path);
+  }
+  // compared without sums or products that could overflow
+  if (n > size / sizeof(T) ||
+      values_size != n * sizeof(T) ||
+      bitmap_size != n / 8 + (n % 8 != 0) ||
+      values_offset > size || values_size > size - values_offset ||
+      bitmap_offset > size || bitmap_size > size - bitmap_offset) {
+    throw std::runtime_error("Column file " + path + " is truncated");
+  }
+  // the values are scanned in place, as `T`s, from a page-aligned mapping
+  if (values_offset % alignof(T) != 0) {
+    throw std::runtime_error("Misaligned values in column file " + path);
+  }
+}
 
-struct sum_ignore_nulls_batched : public task {
-  sum_ignore_nulls_batched() : task("sum_ignore_nulls_batched") {}
 
-  void run_once(const input_data& data) override {
-    const size_t n = data.n;
-    const T* x = data.data.data();
-    size_t batches = n / 8;
-    for (size_t i = 0; i < batches; ++i) {
-      total += x[0] + x[1] + x[2] + x[3] + x[4] + x[5] + x[6] + x[7];
-      x += 8;
-    }
-    for (size_t i = batches * 8; i < n; ++i) {
-      total += *x++;
+// Minimal reader of flatbuffers, sufficient for walking the Arrow IPC
+// metadata without depending on the flatbuffers library. All reads are
+// bounds-checked, since the input comes from an arbitrary file.
+struct flatbuf {
+  const char* base;
+  size_t size;
+
+  template <typename V>
+  V read(size_t pos) const {
+    if (pos > size || size - pos < sizeof(V)) {
+      throw std::runtime_error("Malformed Arrow metadata");
     }
+    V value;
+    memcpy(&value, base + pos, sizeof(V));
+    return value;
   }
+
+  // Follows the unsigned offset stored at `pos`.
+  size_t deref(size_t pos) const { return pos + read<uint32_t>(pos); }
 };
 
 
-struct sum_sentinel_nulls_if : public task {
-  sum_sentinel_nulls_if() : task("sum_sentinel_nulls_if") {}
+struct flatbuf_table {
+  const flatbuf* fb;
+  size_t pos;
 
-  void run_once(const input_data& data) override {
-    constexpr T NA = std::numeric_limits<T>::min();
-    const size_t n = data.n;
-    const T* x = data.data.data();
-    for (size_t i = 0; i < n; ++i) {
-      if (x[i] != NA) total += x[i];
-    }
+  // Position of field `id` within the buffer, or 0 if the field is absent.
+  size_t field(int id) const {
+    size_t vtable = pos - static_cast<size_t>(fb->read<int32_t>(pos));
+    size_t vtable_size = fb->read<uint16_t>(vtable);
+    size_t entry = 4 + 2 * static_cast<size_t>(id);
+    if (entry + 2 > vtable_size) return 0;
+    size_t offset = fb->read<uint16_t>(vtable + entry);
+    return offset? pos + offset : 0;
+  }
+
+  template <typename V>
+  V get(int id, V default_value) const {
+    size_t p = field(id);
+    return p? fb->read<V>(p) : default_value;
+  }
+
+  flatbuf_table table(int id) const {
+    size_t p = field(id);
+    if (!p) throw std::runtime_error("Malformed Arrow metadata");
+    flatbuf_table t = {fb, fb->deref(p)};
+    return t;
+  }
+
+  // Returns the position of the first element of vector field `id`, and
+  // stores the number of its elements into `length`.
+  size_t vector(int id, size_t* length) const {
+    size_t p = field(id);
+    *length = 0;
+    if (!p) return 0;
+    size_t v = fb->deref(p);
+    *length = fb->read<uint32_t>(v);
+    return v + 4;
+  }
+
+  // Element `i` of a vector of tables starting at `elems`.
+  flatbuf_table element(size_t elems, size_t i) const {
+    flatbuf_table t = {fb, fb->deref(elems + 4 * i)};
+    return t;
   }
 };
 
 
-struct sum_sentinel_nulls_mul : public task {
-  sum_sentinel_nulls_mul() : task("sum_sentinel_nulls_mul") {}
+// One record batch worth of a primitive Arrow array.
+struct arrow_chunk {
+  size_t length;
+  size_t null_count;
+  const uint8_t* validity;  // nullptr if the batch has no validity buffer
+  char* values;
+};
 
-  void run_once(const input_data& data) override {
-    constexpr T NA = std::numeric_limits<T>::min();
-    const size_t n = data.n;
-    const T* x = data.data.data();
-    for (size_t i = 0; i < n; ++i) {
-      total += x[i] * (x[i] != NA);
+
+// A primitive column read from an Arrow IPC file or stream. Only the
+// metadata is parsed: the chunks point directly into the file's bytes.
+//
+// Both formats are handled by walking the sequence of encapsulated messages
+// (the file format is the stream format wrapped in "ARROW1" magic and
+// followed by a footer, which is not needed here). Each message is
+// [0xFFFFFFFF] <int32 metadata size> <Message flatbuffer> <body>, where the
+// continuation marker is absent in files written before Arrow 0.15.
+struct arrow_column {
+  // Arrow `Type` union tags of the supported types
+  static constexpr uint8_t type_int = 2;
+  static constexpr uint8_t type_float = 3;
+
+  uint8_t type;
+  int bit_width;
+  bool is_signed;
+  std::vector<arrow_chunk> chunks;
+
+  arrow_column(char* bytes, size_t size, int column)
+    : type(0), bit_width(0), is_signed(true)
+  {
+    size_t pos = 0;
+    if (size >= 8 && memcmp(bytes, "ARROW1", 6) == 0) pos = 8;
+    size_t buffer_index = 0;
+    bool have_schema = false;
+    while (pos + 4 <= size) {
+      flatbuf prefix = {bytes, size};
+      int32_t meta_size = prefix.read<int32_t>(pos);
+      pos += 4;
+      if (meta_size == -1) {
+        meta_size = prefix.read<int32_t>(pos);
+        pos += 4;
+      }
+      if (meta_size <= 0) break;  // end-of-stream marker
+      if (static_cast<size_t>(meta_size) > size - pos) {
+        throw std::runtime_error("Arrow message is truncated");
+      }
+      flatbuf fb = {bytes + pos, static_cast<size_t>(meta_size)};
+      flatbuf_table message = {&fb, fb.deref(0)};
+      uint8_t header_type = message.get<uint8_t>(1, 0);
+      int64_t body_length = message.get<int64_t>(3, 0);
+      char* body = bytes + pos + meta_size;
+      if (body_length < 0 ||
+          static_cast<uint64_t>(body_length) > size - pos - meta_size) {
+        throw std::runtime_error("Arrow message body is truncated");
+      }
+      if (header_type == 1) {  // Schema
+        buffer_index = parse_schema(message.table(2), column);
+        have_schema = true;
+      }
+      if (header_type == 3) {  // RecordBatch
+        if (!have_schema) {
+          throw std::runtime_error("Arrow record batch precedes the schema");
+        }
+        parse_batch(message.table(2), body, static_cast<size_t>(body_length),
+                    column, buffer_index);
+      }
+      pos += meta_size + static_cast<size_t>(body_length);
     }
+    if (!have_schema) throw std::runtime_error("Arrow schema not found");
   }
-};
 
+  size_t length() const {
+    size_t n = 0;
+    for (const arrow_chunk& c : chunks) n += c.length;
+    return n;
+  }
 
-struct sum_sentinel_nulls_batched : public task {
-  sum_sentinel_nulls_batched() : task("sum_sentinel_nulls_batched") {}
+  size_t null_count() const {
+    size_t n = 0;
+    for (const arrow_chunk& c : chunks) n += c.null_count;
+    return n;
+  }
 
-  void run_once(const input_data& data) override {
-    constexpr T NA = std::numeric_limits<T>::min();
-    const size_t n = data.n;
-    const size_t nbatches = n / 8;
-    const T* x = data.data.data();
-    for (size_t i = 0; i < nbatches; ++i) {
-      total += x[0] * (x[0] != NA) +
-               x[1] * (x[1] != NA) +
-               x[2] * (x[2] != NA) +
-               x[3] * (x[3] != NA) +
-               x[4] * (x[4] != NA) +
-               x[5] * (x[5] != NA) +
-               x[6] * (x[6] != NA) +
-               x[7] * (x[7] != NA);
-      x += 8;
+private:
+  // Finds the type of field `column`, and returns the index of its first
+  // buffer in the record batches. All preceding fields must be non-nested,
+  // so that the number of buffers they occupy is known; dictionary-encoded
+  // ones are stored as their indices (a validity and a data buffer), whatever
+  // the type of the dictionary.
+  size_t parse_schema(flatbuf_table schema, int column) {
+    size_t nfields;
+    size_t fields = schema.vector(1, &nfields);
+    if (column < 0 || static_cast<size_t>(column) >= nfields) {
+      throw std::runtime_error("Arrow column index is out of range");
     }
-    for (size_t i = nbatches * 8; i < n; ++i) {
-      T val = *x++;
-      total += val * (val != NA);
+    size_t buffer_index = 0;
+    for (int i = 0; i < column; ++i) {
+      flatbuf_table field = schema.element(fields, static_cast<size_t>(i));
+      uint8_t t = field.get<uint8_t>(2, 0);
+      size_t nchildren;
+      field.vector(5, &nchildren);
+      if (field.field(4)) buffer_index += 2;        // dictionary indices
+      else if (t == 1) continue;                    // Null: no buffers
+      else if ((t >= 4 && t <= 5) || (t >= 19 && t <= 20)) buffer_index += 3;
+      else if (t == 12 || t == 13 || t == 14 || t == 16 || t == 17 ||
+               t >= 21 || nchildren) {
+        throw std::runtime_error("Nested Arrow fields before the selected "
+                                 "column are not supported");
+      }
+      else buffer_index += 2;
+    }
+    flatbuf_table field = schema.element(fields, static_cast<size_t>(column));
+    if (field.field(4)) {
+      throw std::runtime_error("Dictionary-encoded Arrow columns are not "
+                               "supported");
+    }
+    type = field.get<uint8_t>(2, 0);
+    if (type == type_int) {
+      flatbuf_table int_type = field.table(3);
+      bit_width = int_type.get<int32_t>(0, 0);
+      is_signed = int_type.get<uint8_t>(1, 0) != 0;
+      if (bit_width != 8 && bit_width != 16 && bit_width != 32 &&
+          bit_width != 64) {
+        throw std::runtime_error("Unsupported Arrow integer width");
+      }
+    } else if (type == type_float) {
+      int16_t precision = field.table(3).get<int16_t>(0, 0);
+      if (precision != 1 && precision != 2) {
+        throw std::runtime_error("Half-precision Arrow floats are not "
+                                 "supported");
+      }
+      bit_width = precision == 1? 32 : 64;
+    } else {
+      throw std::runtime_error("Only integer and floating-point Arrow "
+                               "columns are supported");
     }
+    return buffer_index;
+  }
+
+  void parse_batch(flatbuf_table batch, char* body, size_t body_length,
+                   int column, size_t buffer_index) {
+    if (batch.field(3)) {
+      throw std::runtime_error("Compressed Arrow record batches are not "
+                               "supported");
+    }
+    const flatbuf* fb = batch.fb;
+    size_t nnodes, nbuffers;
+    size_t nodes = batch.vector(1, &nnodes);
+    size_t buffers = batch.vector(2, &nbuffers);
+    if (static_cast<size_t>(column) >= nnodes || buffer_index + 2 > nbuffers) {
+      throw std::runtime_error("Arrow record batch does not match the schema");
+    }
+    // struct FieldNode { long length; long null_count; }
+    // struct Buffer { long offset; long length; }
+    size_t node = nodes + 16 * static_cast<size_t>(column);
+    size_t validity = buffers + 16 * buffer_index;
+    size_t values = validity + 16;
+    int64_t length = fb->read<int64_t>(node);
+    int64_t null_count = fb->read<int64_t>(node + 8);
+    if (length < 0 || null_count < 0 || null_count > length) {
+      throw std::runtime_error("Invalid Arrow field node");
+    }
+    arrow_chunk chunk;
+    chunk.length = static_cast<size_t>(length);
+    chunk.null_count = static_cast<size_t>(null_count);
+    uint64_t validity_offset = fb->read<uint64_t>(validity);
+    uint64_t validity_length = fb->read<uint64_t>(validity + 8);
+    uint64_t values_offset = fb->read<uint64_t>(values);
+    uint64_t values_length = fb->read<uint64_t>(values + 8);
+    // compared without sums or products that could overflow
+    if (validity_offset > body_length ||
+        validity_length > body_length - validity_offset ||
+        values_offset > body_length ||
+        values_length > body_length - values_offset ||
+        chunk.length > values_length / static_cast<size_t>(bit_width / 8) ||
+        (validity_length &&
+         validity_length < chunk.length / 8 + (chunk.length % 8 != 0))) {
+      throw std::runtime_error("Arrow buffers are out of bounds");
+    }
+    chunk.validity = validity_length?
+        reinterpret_cast<const uint8_t*>(body + validity_offset) : nullptr;
+    chunk.values = body + values_offset;
+    chunks.push_back(chunk);
   }
 };
 
 
-struct sum_bitmask_nulls : public task {
-  sum_bitmask_nulls() : task("sum_bitmask_nulls") {}
+// Column-level statistics of the input.
+struct column_stats {
+  size_t n = 0;
+  size_t na_count = 0;
 
-  void run_once(const input_data& data) override {
-    const size_t n = data.n;
-    const T* x = data.data.data();
-    const uint8_t* valid_bitmap = data.namask.data();
+  bool all_valid() const { return na_count == 0; }
+  bool all_na() const { return na_count == n; }
+};
+
+
+// Range of the values of the column: of the valid values only (zero if there
+// are none), and of all the stored values, including whatever the NA slots
+// hold (e.g. the sentinel).
+struct value_range {
+  int64_t valid_min = 0, valid_max = 0;
+  int64_t all_min = 0, all_max = 0;
+
+  void build(const T* x, const uint8_t* valid_bitmap, size_t n) {
+    T vmin = std::numeric_limits<T>::max(), vmax = std::numeric_limits<T>::min();
+    T amin = vmin, amax = vmax;
+    bool any_valid = false;
     for (size_t i = 0; i < n; ++i) {
-      total += x[i] * ((valid_bitmap[i/8] >> (i & 7)) & 1);
+      amin = std::min(amin, x[i]);
+      amax = std::max(amax, x[i]);
+      if ((valid_bitmap[i/8] >> (i & 7)) & 1) {
+        vmin = std::min(vmin, x[i]);
+        vmax = std::max(vmax, x[i]);
+        any_valid = true;
+      }
     }
+    valid_min = any_valid? vmin : 0;
+    valid_max = any_valid? vmax : 0;
+    all_min = n? amin : 0;
+    all_max = n? amax : 0;
+  }
+
+  // Largest absolute value among the valid values, or among all values.
+  int64_t max_abs(bool all) const {
+    return all? std::max(-all_min, all_max) : std::max(-valid_min, valid_max);
   }
 };
 
 
-struct sum_bitmask_nulls_batched : public task {
-  sum_bitmask_nulls_batched() : task("sum_bitmask_nulls_batched") {}
+// Per-block summary of the validity bitmap (a "zone map"): for each block of
+// `block_size` rows, the number of valid values and whether the block is
+// entirely valid or entirely NA. Kernels consult it to skip all-NA blocks and
+// to use NA-unaware loops on all-valid blocks.
+struct zone_map {
+  static constexpr size_t block_size = 4096;  // multiple of 64
+  static constexpr uint8_t all_valid = 1;
+  static constexpr uint8_t all_na = 2;
 
-  void run_once(const input_data& data) override {
-    const size_t n = data.n;
-    const size_t nbatches = n / 8;
-    const T* x = data.data.data();
-    const uint8_t* valid_bitmap = data.namask.data();
-    for (size_t i = 0; i < nbatches; ++i) {
-      uint8_t valid_byte = valid_bitmap[i];
-      total += x[0] * (valid_byte & 1) +
-               x[1] * ((valid_byte >> 1) & 1) +
-               x[2] * ((valid_byte >> 2) & 1) +
-               x[3] * ((valid_byte >> 3) & 1) +
-               x[4] * ((valid_byte >> 4) & 1) +
-               x[5] * ((valid_byte >> 5) & 1) +
-               x[6] * ((valid_byte >> 6) & 1) +
-               x[7] * ((valid_byte >> 7) & 1);
-      x += 8;
-    }
-    for (size_t i = nbatches * 8; i < n; ++i) {
-      T val = *x++;
-      total += val * ((valid_bitmap[i/8] >> (i & 7)) & 1);
+  struct block {
+    uint16_t valid_count;
+    uint8_t flags;
+  };
+  std::vector<block> blocks;
+
+  void build(const uint8_t* valid_bitmap, size_t n) {
+    const size_t nblocks = (n + block_size - 1) / block_size;
+    blocks.resize(nblocks);
+    for (size_t b = 0; b < nblocks; ++b) {
+      size_t i0 = b * block_size;
+      size_t len = std::min(block_size, n - i0);
+      const uint8_t* bits = valid_bitmap + i0 / 8;
+      size_t count = 0;
+      size_t nwords = len / 64;
+      for (size_t i = 0; i < nwords; ++i) {
+        uint64_t word;
+        memcpy(&word, bits + i * 8, sizeof(word));
+        count += static_cast<size_t>(__builtin_popcountll(word));
+      }
+      for (size_t i = nwords * 64; i < len; ++i) {
+        count += (bits[i/8] >> (i & 7)) & 1;
+      }
+      blocks[b].valid_count = static_cast<uint16_t>(count);
+      blocks[b].flags = count == len? all_valid : count == 0? all_na : 0;
     }
   }
+
+  size_t storage_bytes() const { return blocks.size() * sizeof(block); }
 };
+constexpr size_t zone_map::block_size;
 
 
-struct sum_bitmask_nulls_shortcut : public task {
-  sum_bitmask_nulls_shortcut() : task("sum_bitmask_nulls_shortcut") {}
+// Sparse NA encoding: the sorted positions of the NAs. The positions are kept
+// both as 64-bit and as 32-bit indices; the latter only when all positions
+// fit into 32 bits.
+struct sparse_nas {
+  std::vector<uint64_t> pos64;
+  std::vector<uint32_t> pos32;
 
-  void run_once(const input_data& data) override {
-    const size_t n = data.n;
-    const size_t nbatches = n / 8;
-    const T* x = data.data.data();
-    const uint8_t* valid_bitmap = data.namask.data();
-    for (size_t i = 0; i < nbatches; ++i) {
-      uint8_t valid_byte = valid_bitmap[i];
-      if (valid_byte == 0xFF) {
-        total += x[0] + x[1] + x[2] + x[3] + x[4] +
-                 x[5] + x[6] + x[7];
-      } else {
-        total += x[0] * (valid_byte & 1) +
-                 x[1] * ((valid_byte >> 1) & 1) +
-                 x[2] * ((valid_byte >> 2) & 1) +
-                 x[3] * ((valid_byte >> 3) & 1) +
-                 x[4] * ((valid_byte >> 4) & 1) +
-                 x[5] * ((valid_byte >> 5) & 1) +
-                 x[6] * ((valid_byte >> 6) & 1) +
-                 x[7] * ((valid_byte >> 7) & 1);
+  void build(const uint8_t* valid_bitmap, size_t n) {
+    pos64.clear();
+    pos32.clear();
+    for (size_t i = 0; i < n; i += 64) {
+      uint64_t word = 0;
+      memcpy(&word, valid_bitmap + i / 8, std::min<size_t>(8, (n - i + 7) / 8));
+      uint64_t na_bits = ~word;
+      if (n - i < 64) na_bits &= (uint64_t(1) << (n - i)) - 1;
+      while (na_bits) {
+        pos64.push_back(i + static_cast<size_t>(__builtin_ctzll(na_bits)));
+        na_bits &= na_bits - 1;
       }
-      x += 8;
     }
-    for (size_t i = nbatches * 8; i < n; ++i) {
-      T val = *x++;
-      total += val * ((valid_bitmap[i/8] >> (i & 7)) & 1);
+    if (n <= size_t(std::numeric_limits<uint32_t>::max()) + 1) {
+      pos32.assign(pos64.begin(), pos64.end());
     }
   }
+
+  // Positions as indices of type I, or null if they do not fit into I.
+  template <typename I>
+  const I* positions() const;
+
+  size_t count() const { return pos64.size(); }
 };
 
+template <>
+inline const uint64_t* sparse_nas::positions<uint64_t>() const {
+  return pos64.data();
+}
 
-struct sum_sentinel_nulls_omp1 : public task {
-  int nthreads;
-  sum_sentinel_nulls_omp1(int nth) : task("sum_sentinel_nulls_omp1") {
-    nthreads = nth;
-  }
+template <>
+inline const uint32_t* sparse_nas::positions<uint32_t>() const {
+  return pos32.size() == pos64.size()? pos32.data() : nullptr;
+}
 
-  void run_once(const input_data& data) override {
-    constexpr T NA = std::numeric_limits<T>::min();
-    const size_t n = data.n;
-    const T* x = data.data.data();
-    #pragma omp parallel num_threads(nthreads)
-    {
-      size_t nth = static_cast<size_t>(omp_get_num_threads());
-      size_t ith = static_cast<size_t>(omp_get_thread_num());
-      int64_t subtotal = 0;
-      for (size_t i = ith; i < n; i += nth) {
-        subtotal += x[i] * (x[i] != NA);
+
+// Roaring-style compressed encoding of the NAs. The vector is split into
+// chunks of 65536 rows, and the NA positions within each chunk (as 16-bit
+// offsets) are stored in whichever container is the smallest:
+//   - none: the chunk has no NAs;
+//   - array: sorted list of the NA offsets, 2 bytes per NA;
+//   - bitmap: 1024 words with a bit set for every NA, 8 KB;
+//   - run: sorted list of NA runs as (start, length - 1) pairs, 4 bytes per
+//     run.
+// Unlike real roaring bitmaps, every chunk has a header (including the
+// chunks without NAs), so that chunk `c` is simply `containers[c]`.
+struct roaring_nas {
+  static constexpr size_t chunk_size = 65536;
+  enum kind : uint8_t { none, array, bitmap, run };
+
+  struct container {
+    kind type;
+    uint32_t count;   // number of NAs (array), or of runs (run)
+    size_t offset;    // position of the data in `arrays`, `bitmaps` or `runs`
+  };
+  std::vector<container> containers;
+  std::vector<uint16_t> arrays;
+  std::vector<uint64_t> bitmaps;
+  std::vector<uint16_t> runs;
+
+  void build(const uint8_t* valid_bitmap, size_t n) {
+    containers.clear();
+    arrays.clear();
+    bitmaps.clear();
+    runs.clear();
+    std::vector<uint64_t> words(chunk_size / 64);
+    for (size_t c0 = 0; c0 < n; c0 += chunk_size) {
+      size_t len = std::min(chunk_size, n - c0);
+      size_t nwords = (len + 63) / 64;
+      std::fill(words.begin(), words.end(), uint64_t(0));
+      size_t nas = 0, nruns = 0;
+      bool prev = false;
+      for (size_t w = 0; w < nwords; ++w) {
+        uint64_t word = 0;
+        size_t i = c0 + w * 64;
+        memcpy(&word, valid_bitmap + i / 8, std::min<size_t>(8, (n - i + 7) / 8));
+        uint64_t na_bits = ~word;
+        if (n - i < 64) na_bits &= (uint64_t(1) << (n - i)) - 1;
+        words[w] = na_bits;
+        nas += static_cast<size_t>(__builtin_popcountll(na_bits));
+        // a run starts at every NA bit whose predecessor is valid
+        uint64_t starts = na_bits & ~((na_bits << 1) | uint64_t(prev));
+        nruns += static_cast<size_t>(__builtin_popcountll(starts));
+        prev = na_bits >> 63;
       }
-      #pragma omp atomic update
-      total += subtotal;
+      container cont = {none, 0, 0};
+      size_t array_bytes = 2 * nas;
+      size_t bitmap_bytes = chunk_size / 8;
+      size_t run_bytes = 4 * nruns;
+      if (nas == 0) {
+        // no container
+      } else if (run_bytes <= array_bytes && run_bytes <= bitmap_bytes) {
+        cont = {run, static_cast<uint32_t>(nruns), runs.size()};
+        for (size_t i = 0; i < len; ) {
+          if (!((words[i / 64] >> (i & 63)) & 1)) { ++i; continue; }
+          size_t start = i;
+          while (i < len && ((words[i / 64] >> (i & 63)) & 1)) ++i;
+          runs.push_back(static_cast<uint16_t>(start));
+          runs.push_back(static_cast<uint16_t>(i - start - 1));
+        }
+      } else if (array_bytes <= bitmap_bytes) {
+        cont = {array, static_cast<uint32_t>(nas), arrays.size()};
+        for (size_t w = 0; w < nwords; ++w) {
+          for (uint64_t bits = words[w]; bits; bits &= bits - 1) {
+            arrays.push_back(static_cast<uint16_t>(
+                w * 64 + static_cast<size_t>(__builtin_ctzll(bits))));
+          }
+        }
+      } else {
+        cont = {bitmap, static_cast<uint32_t>(nas), bitmaps.size()};
+        bitmaps.insert(bitmaps.end(), words.begin(), words.end());
+      }
+      containers.push_back(cont);
     }
   }
-};
 
+  size_t storage_bytes() const {
+    return containers.size() * sizeof(container) +
+           arrays.size() * sizeof(uint16_t) +
+           bitmaps.size() * sizeof(uint64_t) +
+           runs.size() * sizeof(uint16_t);
+  }
 
-struct sum_sentinel_nulls_omp2 : public task {
-  int nthreads;
-  sum_sentinel_nulls_omp2(int nth) : task("sum_sentinel_nulls_omp2") {
-    nthreads = nth;
+  size_t count(kind type) const {
+    size_t k = 0;
+    for (const container& cont : containers) k += cont.type == type;
+    return k;
   }
+};
+constexpr size_t roaring_nas::chunk_size;
 
-  void run_once(const input_data& data) override {
-    constexpr T NA = std::numeric_limits<T>::min();
-    const size_t n = data.n;
+
+// Run-length encoding of the column: maximal runs of equal valid values, and
+// maximal runs of NAs. Each run stores its value and its length; runs of NAs
+// are marked with the flag `na_run` in the length (their value is 0).
+struct rle_column {
+  static constexpr uint32_t na_run = uint32_t(1) << 31;
+  static constexpr uint32_t max_length = na_run - 1;
+
+  std::vector<T> values;
+  std::vector<uint32_t> lengths;
+
+  void build(const T* x, const uint8_t* valid_bitmap, size_t n) {
+    values.clear();
+    lengths.clear();
+    size_t i = 0;
+    while (i < n) {
+      bool valid = (valid_bitmap[i/8] >> (i & 7)) & 1;
+      T value = valid? x[i] : 0;
+      size_t j = i + 1;
+      while (j < n && j - i < max_length &&
+             ((valid_bitmap[j/8] >> (j & 7)) & 1) == valid &&
+             (!valid || x[j] == value)) ++j;
+      values.push_back(value);
+      lengths.push_back(static_cast<uint32_t>(j - i) | (valid? 0 : na_run));
+      i = j;
+    }
+  }
+
+  size_t storage_bytes() const {
+    return values.size() * sizeof(T) + lengths.size() * sizeof(uint32_t);
+  }
+};
+
+
+// Dictionary encoding of the column: the distinct valid values, and for each
+// row the code of its value. Code 0 stands for NA. The codes are 8, 16 or
+// 32 bits wide, depending on the size of the dictionary; only one of the
+// code vectors is filled.
+struct dict_column {
+  std::vector<T> dict;   // dict[0] is a placeholder for the NA code
+  std::vector<uint8_t> codes8;
+  std::vector<uint16_t> codes16;
+  std::vector<uint32_t> codes32;
+  int code_bits = 8;
+
+  void build(const T* x, const uint8_t* valid_bitmap, size_t n) {
+    dict.assign(1, 0);
+    codes8.clear();
+    codes16.clear();
+    codes32.clear();
+    for (size_t i = 0; i < n; ++i) {
+      if ((valid_bitmap[i/8] >> (i & 7)) & 1) dict.push_back(x[i]);
+    }
+    std::sort(dict.begin() + 1, dict.end());
+    dict.erase(std::unique(dict.begin() + 1, dict.end()), dict.end());
+    code_bits = dict.size() <= 0x100? 8 : dict.size() <= 0x10000? 16 : 32;
+    std::vector<uint32_t> codes(n);
+    for (size_t i = 0; i < n; ++i) {
+      if ((valid_bitmap[i/8] >> (i & 7)) & 1) {
+        codes[i] = static_cast<uint32_t>(
+            std::lower_bound(dict.begin() + 1, dict.end(), x[i]) - dict.begin());
+      }
+    }
+    if (code_bits == 8) codes8.assign(codes.begin(), codes.end());
+    if (code_bits == 16) codes16.assign(codes.begin(), codes.end());
+    if (code_bits == 32) codes32.swap(codes);
+  }
+
+  size_t storage_bytes() const {
+    return dict.size() * sizeof(T) + codes8.size() + 2 * codes16.size() +
+           4 * codes32.size();
+  }
+};
+
+
+// Frame-of-reference bit-packed encoding of the values: each valid value is
+// stored as `value - base` (where `base` is the smallest valid value) in
+// `width` bits. With `na_code` set, NAs are stored as the all-ones code (the
+// sentinel idea applied to packed data); otherwise NA slots hold code 0 and
+// the validity bitmap of the column must be used alongside.
+//
+// The codes are laid out as in BP128: in blocks of 128 values, where value
+// `i` of the block goes to 32-bit lane `i % 4` and row `i / 4`. The 32 rows
+// of each lane are packed contiguously, `width` bits per row, so that a
+// block occupies `width` 128-bit words, and 4 values are unpacked at once
+// with SIMD shifts. The last block is padded with NA codes (or zeros).
+struct packed_column {
+  static constexpr size_t block_size = 128;
+
+  T base = 0;
+  int width = 0;
+  bool na_code = false;
+  std::vector<uint32_t> words;
+
+  // Packs the column into at least `min_width` bits per value (or fewer if 0
+  // is given; at most 32), widening as needed to fit the range of values.
+  // With the NA code, 33 bits would be needed if the valid values spanned
+  // the whole range of T, i.e. included INT32_MIN. The sentinel encoding
+  // cannot represent that value either, and the packed column then does the
+  // same as the sentinel methods: it codes INT32_MIN as NA.
+  void build(const T* x, const uint8_t* valid_bitmap, size_t n, int min_width,
+             bool with_na_code) {
+    na_code = with_na_code;
+    bool any_valid = false;
+    T lo = 0, hi = 0;
+    for (size_t i = 0; i < n; ++i) {
+      if (!((valid_bitmap[i/8] >> (i & 7)) & 1)) continue;
+      lo = any_valid? std::min(lo, x[i]) : x[i];
+      hi = any_valid? std::max(hi, x[i]) : x[i];
+      any_valid = true;
+    }
+    // the largest code, plus the NA code if any
+    uint64_t max_code = uint64_t(int64_t(hi) - int64_t(lo)) + na_code;
+    const bool min_as_na = max_code > std::numeric_limits<uint32_t>::max();
+    if (min_as_na) {
+      lo++;
+      max_code--;
+    }
+    base = lo;
+    width = std::min(32, std::max(1, min_width));
+    while (width < 32 && (max_code >> width)) ++width;
+    const uint32_t fill = na_code? na() : 0;
+    const size_t nblocks = (n + block_size - 1) / block_size;
+    words.assign(nblocks * 4 * static_cast<size_t>(width), 0);
+    for (size_t b = 0; b < nblocks; ++b) {
+      uint32_t* w = words.data() + b * 4 * static_cast<size_t>(width);
+      for (size_t j = 0; j < block_size; ++j) {
+        size_t i = b * block_size + j;
+        uint32_t code = fill;
+        if (i < n && ((valid_bitmap[i/8] >> (i & 7)) & 1) &&
+            !(min_as_na && x[i] < base)) {
+          code = static_cast<uint32_t>(int64_t(x[i]) - int64_t(base));
+        }
+        size_t lane = j % 4, offset = (j / 4) * static_cast<size_t>(width);
+        size_t k = offset / 32, shift = offset % 32;
+        w[k * 4 + lane] |= code << shift;
+        if (shift + static_cast<size_t>(width) > 32) {
+          w[(k + 1) * 4 + lane] |= code >> (32 - shift);
+        }
+      }
+    }
+  }
+
+  // The all-ones code.
+  uint32_t na() const {
+    return width == 32? ~uint32_t(0) : (uint32_t(1) << width) - 1;
+  }
+
+  // Code of value `i`.
+  uint32_t code(size_t i) const {
+    const uint32_t* w = words.data() + (i / block_size) * 4 * static_cast<size_t>(width);
+    size_t j = i % block_size;
+    size_t lane = j % 4, offset = (j / 4) * static_cast<size_t>(width);
+    size_t k = offset / 32, shift = offset % 32;
+    uint64_t bits = w[k * 4 + lane] >> shift;
+    if (shift + static_cast<size_t>(width) > 32) {
+      bits |= uint64_t(w[(k + 1) * 4 + lane]) << (32 - shift);
+    }
+    return static_cast<uint32_t>(bits) & na();
+  }
+
+  size_t storage_bytes() const { return words.size() * sizeof(uint32_t); }
+};
+constexpr size_t packed_column::block_size;
+
+
+struct input_data {
+  size_t n;
+  buffer<T> data;
+  buffer<uint8_t> namask;
+  alloc_policy alloc;
+  // Set when `data` and `namask` are views into a mapped column file.
+  std::unique_ptr<mapped_file> source;
+  // Distribution of the NAs created by `fill_nas()`: "uniform" (each value is
+  // NA with probability p independently), or "clustered" (alternating runs of
+  // NAs and of valid values with geometrically distributed lengths; the NA
+  // runs have mean length `na_run`, and the valid runs are sized so that the
+  // overall fraction of NAs is p).
+  std::string na_pattern;
+  double na_run;
+  // Mean length of the runs of equal values created by `generate()`: with
+  // 1 every value is drawn independently, otherwise each drawn value is
+  // repeated a geometrically distributed number of times.
+  double value_run;
+  // Minimum bit width of the bit-packed encodings (0 for the narrowest one
+  // that fits the values).
+  int pack_bits;
+  // If positive, the buffers are first touched in parallel by this many OMP
+  // threads, split statically into one contiguous range per thread. On NUMA
+  // systems this puts each page on the node of the thread that scans it in
+  // the statically scheduled tasks (`*_omp2`, and the per-node bandwidth
+  // report); the chunked `_pool`/`_omp_chunked` tasks hand out their chunks
+  // dynamically, so their threads also read pages of other nodes.
+  // This supersedes `alloc.prefault`.
+  int first_touch_threads;
+  // If set, the encodings that are built on first use (roaring, run-length,
+  // dictionary, bit-packed) print a summary and their build time when they
+  // are built, so that a run reports exactly the encodings its tasks use.
+  bool report_builds;
+
+  input_data(size_t _n)
+    : n(_n), na_pattern("uniform"), na_run(1000), value_run(1), pack_bits(0),
+      first_touch_threads(0), report_builds(false),
+      stats_valid(false), zones_valid(false), sparse_valid(false),
+      roaring_valid(false), rle_valid(false), dict_valid(false),
+      packed_valid(false), range_valid(false) {}
+
+  // Statistics of the column, computed from the validity bitmap on first use
+  // and cached until the content of the column changes.
+  const column_stats& stats() const {
+    if (!stats_valid) {
+      cached_stats.n = n;
+      cached_stats.na_count = n - count_valid();
+      stats_valid = true;
+    }
+    return cached_stats;
+  }
+
+  // Range of the values, computed on first use and cached in the same way
+  // (separately from `stats()`, which only reads the bitmap).
+  const value_range& range() const {
+    if (!range_valid) {
+      cached_range.build(data.data(), namask.data(), n);
+      range_valid = true;
+    }
+    return cached_range;
+  }
+
+  // Zone map of the validity bitmap, built on first use and cached in the
+  // same way as the statistics.
+  const zone_map& zones() const {
+    if (!zones_valid) {
+      cached_zones.build(namask.data(), n);
+      zones_valid = true;
+    }
+    return cached_zones;
+  }
+
+  // Sparse encoding of the NAs, built on first use and cached in the same way.
+  const sparse_nas& sparse() const {
+    if (!sparse_valid) {
+      cached_sparse.build(namask.data(), n);
+      sparse_valid = true;
+    }
+    return cached_sparse;
+  }
+
+  // Roaring-style encoding of the NAs, built on first use and cached.
+  const roaring_nas& roaring() const {
+    if (!roaring_valid) {
+      auto time0 = std::chrono::high_resolution_clock::now();
+      cached_roaring.build(namask.data(), n);
+      roaring_valid = true;
+      if (report_builds) {
+        const roaring_nas& r = cached_roaring;
+        printf("  roaring: %zu array, %zu bitmap, %zu run containers, %zu "
+               "bytes (%.2f%% of the bitmap), built in %g s\n",
+               r.count(roaring_nas::array), r.count(roaring_nas::bitmap),
+               r.count(roaring_nas::run), r.storage_bytes(),
+               100.0 * r.storage_bytes() / std::max<size_t>(1, namask.size()),
+               seconds_since(time0));
+      }
+    }
+    return cached_roaring;
+  }
+
+  // Run-length and dictionary encodings of the column, built on first use and
+  // cached.
+  const rle_column& rle() const {
+    if (!rle_valid) {
+      auto time0 = std::chrono::high_resolution_clock::now();
+      cached_rle.build(data.data(), namask.data(), n);
+      rle_valid = true;
+      if (report_builds) {
+        printf("  rle: %zu runs, %zu bytes, built in %g s\n",
+               cached_rle.values.size(), cached_rle.storage_bytes(),
+               seconds_since(time0));
+      }
+    }
+    return cached_rle;
+  }
+
+  const dict_column& dictionary() const {
+    if (!dict_valid) {
+      auto time0 = std::chrono::high_resolution_clock::now();
+      cached_dict.build(data.data(), namask.data(), n);
+      dict_valid = true;
+      if (report_builds) {
+        printf("  dictionary: %zu values, %d-bit codes, %zu bytes, built in "
+               "%g s\n", cached_dict.dict.size() - 1, cached_dict.code_bits,
+               cached_dict.storage_bytes(), seconds_since(time0));
+      }
+    }
+    return cached_dict;
+  }
+
+  // Bit-packed encodings of the values, with NAs as the all-ones code, and
+  // with NAs left to the bitmap. Built on first use and cached.
+  const packed_column& packed_sentinel() const {
+    build_packed();
+    return cached_packed_sentinel;
+  }
+
+  const packed_column& packed_values() const {
+    build_packed();
+    return cached_packed_values;
+  }
+
+  // Must be called whenever the values or the bitmap are modified (or
+  // replaced) other than through the methods of this struct.
+  void invalidate_stats() {
+    stats_valid = zones_valid = sparse_valid = roaring_valid = false;
+    rle_valid = dict_valid = packed_valid = range_valid = false;
+  }
+
+  void allocate() {
+    invalidate_stats();
+    alloc_policy policy = alloc;
+    if (first_touch_threads > 0) policy.prefault = false;
+    data.allocate(n, policy);
+    namask.allocate((n + 7) / 8, policy);
+    if (first_touch_threads > 0) {
+      const size_t nbatches = (n + 7) / 8;
+      T* x = data.data();
+      uint8_t* valid_bitmap = namask.data();
+      #pragma omp parallel for schedule(static) num_threads(first_touch_threads)
+      for (size_t i = 0; i < nbatches; ++i) {
+        valid_bitmap[i] = 0;
+        size_t iend = std::min(n, i * 8 + 8);
+        for (size_t j = i * 8; j < iend; ++j) x[j] = 0;
+      }
+    }
+  }
+
+  void generate(size_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<T> dist(0, 100);
+    allocate();
+    if (value_run > 1) {
+      std::geometric_distribution<size_t> run_len(1 / value_run);
+      for (size_t i = 0; i < n; ) {
+        size_t iend = std::min(n, i + 1 + run_len(rng));
+        std::fill(data.begin() + i, data.begin() + iend, dist(rng));
+        i = iend;
+      }
+      return;
+    }
+    std::generate(data.begin(), data.end(),
+                  [&]() { return dist(rng); });
+  }
+
+  void fill_nas(double p, size_t seed) {
+    // Note: for bitmask array, bit=1 for valid values, and 0 for NA values.
+    constexpr T na_value = std::numeric_limits<T>::min();
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> dist(0, 1);
+    invalidate_stats();
+    std::fill(namask.begin(), namask.end(), uint8_t(0xFF));
+    if (na_pattern == "clustered") {
+      if (p <= 0) return;
+      double valid_run = p < 1? std::max(1.0, na_run * (1 - p) / p) : 0;
+      std::geometric_distribution<size_t> na_len(1 / std::max(1.0, na_run));
+      std::geometric_distribution<size_t> valid_len(1 / std::max(1.0, valid_run));
+      // start inside a run of either kind, proportionally to its share
+      bool is_na = dist(rng) < p;
+      size_t i = 0;
+      while (i < n) {
+        if (!is_na && p >= 1) { is_na = true; continue; }
+        size_t len = 1 + (is_na? na_len(rng) : valid_len(rng));
+        size_t iend = std::min(n, i + len);
+        if (is_na) {
+          for (; i < iend; ++i) {
+            namask[i/8] &= ~uint8_t(1 << (i & 7));
+            data[i] = na_value;
+          }
+        }
+        i = iend;
+        is_na = !is_na;
+      }
+      return;
+    }
+    for (size_t i = 0; i < n; ++i) {
+      if (dist(rng) < p) {
+        namask[i/8] &= ~uint8_t(1 << (i & 7));
+        data[i] = na_value;
+      }
+    }
+  }
+
+  // Writes the data into a column file (see `column_header`).
+  void write_column(const std::string& path) const {
+    // the blocks of an empty column would lie past the end of the file
+    if (n == 0) throw std::runtime_error("Cannot write an empty column");
+    column_header hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, column_magic, sizeof(hdr.magic));
+    hdr.version = 1;
+    hdr.type = 1;
+    hdr.elem_size = sizeof(T);
+    hdr.na_encoding = column_sentinel | column_bitmap;
+    hdr.n = n;
+    hdr.na_value = std::numeric_limits<T>::min();
+    hdr.values_offset = column_alignment;
+    hdr.values_size = n * sizeof(T);
+    hdr.bitmap_offset = align_up(hdr.values_offset + hdr.values_size);
+    hdr.bitmap_size = (n + 7) / 8;
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) throw std::runtime_error("Cannot create file " + path);
+    bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1 &&
+              fseek(f, static_cast<long>(hdr.values_offset), SEEK_SET) == 0 &&
+              fwrite(data.data(), 1, hdr.values_size, f) == hdr.values_size &&
+              fseek(f, static_cast<long>(hdr.bitmap_offset), SEEK_SET) == 0 &&
+              fwrite(namask.data(), 1, hdr.bitmap_size, f) == hdr.bitmap_size;
+    ok = (fclose(f) == 0) && ok;
+    if (!ok) throw std::runtime_error("Failed to write file " + path);
+  }
+
+  // Maps a column file, making `data` and `namask` zero-copy views into it.
+  void map_column(const std::string& path, bool populate,
+                  const std::string& advice) {
+    source.reset(new mapped_file(path, populate, advice));
+    const char* base = source->bytes();
+    column_header hdr;
+    hdr.read(base, source->size, path);
+    n = hdr.n;
+    invalidate_stats();
+    data.view(reinterpret_cast<const T*>(base + hdr.values_offset), n);
+    namask.view(reinterpret_cast<const uint8_t*>(base + hdr.bitmap_offset),
+                hdr.bitmap_size);
+  }
+
+  // Loads column `column` of an Arrow IPC file or stream. When the column is
+  // a single record batch of int32 values, the values and the validity
+  // bitmap (which has the same layout as `namask`) are used in place from the
+  // privately mapped file. The sentinel representation is then created by
+  // writing the NA value into the NA slots of the mapped values, whose
+  // content is undefined in Arrow anyway: only the pages containing NAs get
+  // copied. Other value types, or multiple record batches, are converted
+  // into newly allocated buffers.
+  void load_arrow(const std::string& path, int column) {
+    constexpr T na_value = std::numeric_limits<T>::min();
+    source.reset(new mapped_file(path, false, "sequential", true));
+    arrow_column col(source->bytes(), source->size, column);
+    n = col.length();
+    invalidate_stats();
+    bool int32_values = col.type == arrow_column::type_int &&
+                        col.bit_width == 32 && col.is_signed;
+    bool zero_copy = col.chunks.size() == 1 && int32_values &&
+                     reinterpret_cast<uintptr_t>(col.chunks[0].values) %
+                         alignof(T) == 0;
+    if (zero_copy) {
+      data.view(reinterpret_cast<T*>(col.chunks[0].values), n);
+    } else {
+      data.allocate(n, alloc);
+      size_t offset = 0;
+      for (const arrow_chunk& c : col.chunks) {
+        convert_values(col, c, data.data() + offset);
+        offset += c.length;
+      }
+    }
+    if (col.chunks.size() == 1 && col.chunks[0].validity) {
+      namask.view(col.chunks[0].validity, (n + 7) / 8);
+    } else {
+      namask.allocate((n + 7) / 8, alloc);
+      std::fill(namask.begin(), namask.end(), uint8_t(0));
+      size_t offset = 0;
+      for (const arrow_chunk& c : col.chunks) {
+        copy_bits(c.validity, c.length, namask.data(), offset);
+        offset += c.length;
+      }
+    }
+    // Valid values equal to the sentinel (only possible in int32 columns,
+    // the conversion clamps the others) are moved off it.
+    T* x = data.data();
+    const uint8_t* valid_bitmap = namask.data();
+    size_t nas = 0, clamped = 0;
+    for (size_t i = 0; i < n; ++i) {
+      if (!((valid_bitmap[i/8] >> (i & 7)) & 1)) {
+        x[i] = na_value;
+        nas++;
+      } else if (x[i] == na_value) {
+        x[i] = na_value + 1;
+        clamped++;
+      }
+    }
+    printf("  Arrow column %d: n = %zu, %zu NAs, values %s\n", column, n, nas,
+           zero_copy? "mapped in place" : "converted");
+    if (clamped) {
+      printf("  %zu valid values equal to the NA sentinel were clamped to "
+             "%d\n", clamped, na_value + 1);
+    }
+  }
+
+  static size_t align_up(size_t offset) {
+    return (offset + column_alignment - 1) / column_alignment * column_alignment;
+  }
+
+private:
+  mutable column_stats cached_stats;
+  mutable bool stats_valid;
+  mutable zone_map cached_zones;
+  mutable bool zones_valid;
+  mutable sparse_nas cached_sparse;
+  mutable bool sparse_valid;
+  mutable roaring_nas cached_roaring;
+  mutable bool roaring_valid;
+  mutable rle_column cached_rle;
+  mutable bool rle_valid;
+  mutable dict_column cached_dict;
+  mutable bool dict_valid;
+  mutable packed_column cached_packed_sentinel;
+  mutable packed_column cached_packed_values;
+  mutable bool packed_valid;
+  mutable value_range cached_range;
+  mutable bool range_valid;
+
+  static double seconds_since(
+      std::chrono::high_resolution_clock::time_point time0) {
+    std::chrono::duration<double> diff =
+        std::chrono::high_resolution_clock::now() - time0;
+    return diff.count();
+  }
+
+  void build_packed() const {
+    if (packed_valid) return;
+    auto time0 = std::chrono::high_resolution_clock::now();
+    cached_packed_sentinel.build(data.data(), namask.data(), n, pack_bits, true);
+    cached_packed_values.build(data.data(), namask.data(), n, pack_bits, false);
+    packed_valid = true;
+    if (report_builds) {
+      printf("  packed: %d bits per value with the NA code (%zu bytes), %d "
+             "bits without, built in %g s\n", cached_packed_sentinel.width,
+             cached_packed_sentinel.storage_bytes(),
+             cached_packed_values.width, seconds_since(time0));
+    }
+  }
+
+  size_t count_valid() const {
+    const uint8_t* valid_bitmap = namask.data();
+    const size_t nwords = n / 64;
+    size_t count = 0;
+    for (size_t i = 0; i < nwords; ++i) {
+      uint64_t word;
+      memcpy(&word, valid_bitmap + i * 8, sizeof(word));
+      count += static_cast<size_t>(__builtin_popcountll(word));
+    }
+    for (size_t i = nwords * 64; i < n; ++i) {
+      count += (valid_bitmap[i/8] >> (i & 7)) & 1;
+    }
+    return count;
+  }
+
+  static void convert_values(const arrow_column& col, const arrow_chunk& c,
+                             T* out) {
+    const char* p = c.values;
+    for (size_t i = 0; i < c.length; ++i) {
+      if (col.type == arrow_column::type_float) {
+        double v = col.bit_width == 32? load<float>(p, i) : load<double>(p, i);
+        // clamp, keeping clear of the NA sentinel
+        v = std::max(std::min(v, 2147483647.0), -2147483647.0);
+        out[i] = std::isnan(v)? 0 : static_cast<T>(v);
+      } else {
+        int64_t v = 0;
+        switch (col.bit_width) {
+          case 8:  v = col.is_signed? load<int8_t>(p, i) : load<uint8_t>(p, i); break;
+          case 16: v = col.is_signed? load<int16_t>(p, i) : load<uint16_t>(p, i); break;
+          case 32: v = col.is_signed? load<int32_t>(p, i) : load<uint32_t>(p, i); break;
+          case 64: v = col.is_signed? load<int64_t>(p, i)
+                                    : static_cast<int64_t>(std::min<uint64_t>(
+                                          load<uint64_t>(p, i), 2147483647));
+                   break;
+        }
+        // clamp, keeping clear of the NA sentinel
+        out[i] = static_cast<T>(std::max<int64_t>(std::min<int64_t>(v,
+                     2147483647), -2147483647));
+      }
+    }
+  }
+
+  template <typename V>
+  static V load(const char* p, size_t i) {
+    V v;
+    memcpy(&v, p + i * sizeof(V), sizeof(V));
+    return v;
+  }
+
+  // Appends `n` bits from `src` (or `n` one-bits if `src` is null) into the
+  // zero-initialized bitmap `dst`, starting at bit `offset`.
+  static void copy_bits(const uint8_t* src, size_t n, uint8_t* dst,
+                        size_t offset) {
+    size_t nbytes = (n + 7) / 8;
+    size_t shift = offset & 7;
+    uint8_t* out = dst + offset / 8;
+    for (size_t j = 0; j < nbytes; ++j) {
+      uint8_t b = src? src[j] : uint8_t(0xFF);
+      if (j == nbytes - 1 && (n & 7)) b &= uint8_t((1 << (n & 7)) - 1);
+      out[j] |= uint8_t(b << shift);
+      if (shift && (b >> (8 - shift))) out[j + 1] |= uint8_t(b >> (8 - shift));
+    }
+  }
+};
+
+
+// Sizes of the CPU data caches, in bytes. On Linux these are read from sysfs
+// (the caches of cpu0); elsewhere, or if sysfs is not readable, typical
+// desktop values are assumed.
+struct cache_info {
+  size_t l1d;
+  size_t l2;
+  size_t l3;
+
+  cache_info() : l1d(32 << 10), l2(256 << 10), l3(8 << 20) {
+    #ifdef __linux__
+      for (int i = 0; i < 8; ++i) {
+        std::string dir = "/sys/devices/system/cpu/cpu0/cache/index" +
+                          std::to_string(i) + "/";
+        std::string type = read_line(dir + "type");
+        std::string level = read_line(dir + "level");
+        std::string size = read_line(dir + "size");
+        if (type.empty() || level.empty() || size.empty()) break;
+        if (type == "Instruction") continue;
+        size_t bytes = std::strtoul(size.c_str(), nullptr, 10);
+        char unit = size.back();
+        if (unit == 'K') bytes <<= 10;
+        if (unit == 'M') bytes <<= 20;
+        if (unit == 'G') bytes <<= 30;
+        if (bytes == 0) continue;
+        if (level == "1") l1d = bytes;
+        if (level == "2") l2 = bytes;
+        if (level == "3") l3 = bytes;
+      }
+    #endif
+    if (l3 < l2) l3 = l2;  // CPUs without an L3 cache
+  }
+
+private:
+  static std::string read_line(const std::string& path) {
+    std::string line;
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) return line;
+    char buf[64];
+    if (fgets(buf, sizeof(buf), f)) line = buf;
+    fclose(f);
+    while (!line.empty() && isspace(line.back())) line.pop_back();
+    return line;
+  }
+};
+
+
+
+// Evicts the buffers of a task from all cache levels, so that its next run
+// has to read them from main memory. Besides the values and the bitmap, tasks
+// read encodings built from them (zone map, sparse list, roaring, RLE,
+// dictionary, bit-packed words) and their own columns and output buffers, so
+// the flusher streams through a scratch buffer twice the size of the
+// last-level cache, which evicts all of them. On x86 the values and the
+// bitmap are first flushed with `clflush` as well, which evicts them even
+// from caches whose replacement policy might retain them.
+struct cache_flusher {
+  std::vector<uint64_t> scratch;
+  uint64_t sink;
+
+  cache_flusher() : sink(0) {}
+
+  void flush(const input_data& data) {
+    if (scratch.empty()) {  // allocated on first use
+      cache_info caches;
+      scratch.resize(2 * caches.l3 / sizeof(uint64_t), 1);
+    }
+    #ifdef __SSE2__
+      flush_range(data.data.data(), data.data.size() * sizeof(T));
+      flush_range(data.namask.data(), data.namask.size());
+      _mm_mfence();
+    #endif
+    // one load per cache line; loads only, so that no dirty lines are left
+    // to be written back during the timed run
+    uint64_t s = sink;
+    for (size_t i = 0; i < scratch.size(); i += 8) {
+      s += scratch[i];
+    }
+    sink = s;
+  }
+
+private:
+  #ifdef __SSE2__
+    static void flush_range(const void* ptr, size_t size) {
+      const char* p = static_cast<const char*>(ptr);
+      for (size_t i = 0; i < size; i += 64) {
+        _mm_clflush(p + i);
+      }
+      if (size) _mm_clflush(p + size - 1);
+    }
+  #endif
+};
+
+
+// Inputs of the same size with independent values and NA patterns. The
+// cache-resident sizes of the working-set sweep rotate through them, so that
+// the branch predictor cannot learn the NA pattern of a single input.
+struct input_rotation {
+  std::vector<std::unique_ptr<input_data>> inputs;
+  size_t next_index;
+
+  input_rotation() : next_index(0) {}
+
+  const input_data& next() {
+    const input_data& in = *inputs[next_index];
+    next_index = (next_index + 1) % inputs.size();
+    return in;
+  }
+};
+
+
+// CPUs available to the process, and the NUMA node of each of them (read from
+// `/sys/devices/system/node`). On non-Linux systems, or without NUMA
+// information, every CPU is assumed to be on node 0. Node ids need not be
+// contiguous; `n_nodes` is one more than the largest one.
+struct cpu_topology {
+  std::vector<int> cpus;     // CPUs in the affinity mask of the process
+  std::vector<int> node_of;  // NUMA node of each CPU, indexed by CPU id
+  int n_nodes;
+
+  cpu_topology() : n_nodes(1) {
+    #ifdef __linux__
+      cpu_set_t mask;
+      CPU_ZERO(&mask);
+      if (sched_getaffinity(0, sizeof(mask), &mask) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+          if (CPU_ISSET(cpu, &mask)) cpus.push_back(cpu);
+        }
+      }
+      node_of.assign(CPU_SETSIZE, 0);
+      for (int node : read_list("/sys/devices/system/node/online")) {
+        std::string path = "/sys/devices/system/node/node" +
+                           std::to_string(node) + "/cpulist";
+        for (int cpu : read_list(path)) {
+          if (cpu < CPU_SETSIZE) node_of[cpu] = node;
+        }
+        n_nodes = std::max(n_nodes, node + 1);
+      }
+    #endif
+    if (cpus.empty()) {
+      for (int i = 0; i < omp_get_num_procs(); ++i) cpus.push_back(i);
+    }
+    if (node_of.empty()) node_of.assign(cpus.back() + 1, 0);
+  }
+
+  int node(int cpu) const {
+    return cpu >= 0 && cpu < static_cast<int>(node_of.size())? node_of[cpu] : 0;
+  }
+
+  // Order in which the threads should be assigned to CPUs: "compact" fills
+  // one NUMA node before moving to the next one, while "scatter" distributes
+  // consecutive threads round-robin across the nodes.
+  std::vector<int> placement(const std::string& policy) const {
+    std::vector<std::vector<int>> by_node(n_nodes);
+    for (int cpu : cpus) by_node[node(cpu)].push_back(cpu);
+    std::vector<int> order;
+    if (policy == "compact") {
+      for (auto& v : by_node) order.insert(order.end(), v.begin(), v.end());
+    } else if (policy == "scatter") {
+      for (size_t i = 0; order.size() < cpus.size(); ++i) {
+        for (auto& v : by_node) {
+          if (i < v.size()) order.push_back(v[i]);
+        }
+      }
+    }
+    return order;
+  }
+
+private:
+  // Reads a sysfs list of ids, a comma-separated list of ranges such as
+  // "0-7,16-23"; empty if the file does not exist.
+  static std::vector<int> read_list(const std::string& path) {
+    std::vector<int> ids;
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) return ids;
+    int lo, hi;
+    while (fscanf(f, "%d", &lo) == 1) {
+      hi = lo;
+      int c = fgetc(f);
+      if (c == '-') {
+        if (fscanf(f, "%d", &hi) != 1) break;
+        c = fgetc(f);
+      }
+      for (int id = std::max(lo, 0); id <= hi; ++id) ids.push_back(id);
+      if (c != ',') break;
+    }
+    fclose(f);
+    return ids;
+  }
+};
+
+
+// Binds the threads of the OMP pool to the CPUs according to the `policy`.
+// The OMP runtime reuses the same worker threads for subsequent parallel
+// regions, so the binding persists for all parallel tasks (regions with
+// fewer threads use the first workers, i.e. the first CPUs in the order).
+static void pin_omp_threads(const cpu_topology& topo,
+                            const std::string& policy, int nthreads) {
+  std::vector<int> order = topo.placement(policy);
+  if (order.empty()) return;
+  #ifdef __linux__
+    #pragma omp parallel num_threads(nthreads)
+    {
+      int ith = omp_get_thread_num();
+      cpu_set_t mask;
+      CPU_ZERO(&mask);
+      CPU_SET(order[static_cast<size_t>(ith) % order.size()], &mask);
+      sched_setaffinity(0, sizeof(mask), &mask);
+    }
+  #else
+    (void) nthreads;
+  #endif
+}
+
+
+//------------------------------------------------------------------------------
+// Parallel executors
+//------------------------------------------------------------------------------
+
+// Type-erased reference to a callable `int64_t f(size_t i0, size_t i1)` that
+// reduces the range of elements [i0, i1).
+struct range_fn {
+  int64_t (*call)(const void* self, size_t i0, size_t i1);
+  const void* self;
+
+  int64_t operator()(size_t i0, size_t i1) const { return call(self, i0, i1); }
+};
+
+
+// Scheduling statistics accumulated over the jobs of an executor.
+struct executor_stats {
+  size_t jobs;
+  size_t chunks;
+  size_t steals;
+  double duration;   // total time of all jobs, in seconds
+  double imbalance;  // total time between the first and the last thread
+                     // finishing their share of the job, in seconds
+
+  executor_stats() { clear(); }
+
+  void clear() {
+    jobs = chunks = steals = 0;
+    duration = imbalance = 0.0;
+  }
+
+  void print(bool with_steals) const {
+    if (!jobs) return;
+    printf("    %.1f chunks/job", static_cast<double>(chunks) / jobs);
+    if (with_steals) printf(", %.2f steals/job", static_cast<double>(steals) / jobs);
+    printf(", tail imbalance %.2f us (%.1f%% of job time)\n",
+           imbalance / jobs * 1e6, 100.0 * imbalance / duration);
+  }
+};
+
+
+// Runs range reductions in parallel. The range [0, n) is split into chunks
+// of `grain` elements (the last one may be shorter); `grain` must be a
+// multiple of 64, so that every chunk starts on a cache line of `data` and on
+// a 64-bit word of the validity bitmap.
+struct executor {
+  const char* name;
+  executor_stats stats;
+
+  explicit executor(const char* name_) : name(name_) {}
+  virtual ~executor() {}
+
+  virtual int64_t reduce(int nthreads, size_t n, size_t grain,
+                         range_fn fn) = 0;
+
+  template <typename F>
+  int64_t parallel_reduce(int nthreads, size_t n, size_t grain, const F& f) {
+    range_fn fn;
+    fn.call = [](const void* self, size_t i0, size_t i1) -> int64_t {
+      return (*static_cast<const F*>(self))(i0, i1);
+    };
+    fn.self = &f;
+    return reduce(nthreads, n, grain, fn);
+  }
+
+  virtual void print_stats() const { stats.print(false); }
+
+  static double seconds_since(std::chrono::steady_clock::time_point t0) {
+    std::chrono::duration<double> diff = std::chrono::steady_clock::now() - t0;
+    return diff.count();
+  }
+};
+
+
+// Baseline executor: OMP dynamic scheduling over the same chunks.
+struct omp_executor : public executor {
+  omp_executor() : executor("omp_chunked") {}
+
+  int64_t reduce(int nthreads, size_t n, size_t grain, range_fn fn) override {
+    const size_t nchunks = (n + grain - 1) / grain;
+    auto time0 = std::chrono::steady_clock::now();
+    double first = std::numeric_limits<double>::max();
+    double last = 0.0;
+    int64_t total = 0;
+    #pragma omp parallel num_threads(nthreads) reduction(+:total)
+    {
+      #pragma omp for schedule(dynamic, 1) nowait
+      for (size_t c = 0; c < nchunks; ++c) {
+        total += fn(c * grain, std::min(n, c * grain + grain));
+      }
+      double finish = seconds_since(time0);
+      #pragma omp critical
+      {
+        first = std::min(first, finish);
+        last = std::max(last, finish);
+      }
+    }
+    stats.jobs++;
+    stats.chunks += nchunks;
+    stats.duration += seconds_since(time0);
+    stats.imbalance += last - first;
+    return total;
+  }
+};
+
+
+// Work-stealing thread pool. Each job's chunks are initially split into equal
+// contiguous ranges, one per worker. A worker takes chunks from the front of
+// its own range; once it runs out, it steals the back half of another
+// worker's range. Both operations are a single CAS on the victim's packed
+// [begin, end) pair, so there are no locks on the hot path. The calling
+// thread participates as worker 0, and the partial results are combined from
+// per-worker slots, each on its own cache line.
+struct thread_pool : public executor {
+  struct alignas(64) worker {
+    std::atomic<uint64_t> range;  // (begin << 32) | end, in chunks
+    int64_t result;
+    size_t chunks;
+    size_t steals;
+    double finish;
+  };
+
+  std::vector<std::thread> threads;
+  worker* workers;
+  int nworkers;
+  std::vector<int> cpus;
+
+  std::mutex mutex;
+  std::condition_variable wakeup;
+  std::atomic<uint64_t> generation;
+  std::atomic<int> pending;
+  bool stopping;
+
+  // Parameters of the current job. `active` is written and read under the
+  // mutex, together with `generation`, so that a worker which wakes up late
+  // for a job it is not part of cannot pair an old generation with the
+  // parameters of the next job.
+  int active;
+  size_t job_n;
+  size_t job_grain;
+  range_fn job_fn;
+  std::chrono::steady_clock::time_point job_start;
+
+  // `cpu_order`, if not empty, gives the CPUs to which the workers are bound.
+  thread_pool(int n, const std::vector<int>& cpu_order)
+    : executor("pool"), nworkers(std::max(n, 1)), cpus(cpu_order),
+      generation(0), pending(0), stopping(false), active(0)
+  {
+    void* mem = nullptr;
+    if (posix_memalign(&mem, 64, sizeof(worker) * nworkers)) {
+      throw std::bad_alloc();
+    }
+    workers = static_cast<worker*>(mem);
+    for (int i = 0; i < nworkers; ++i) new (workers + i) worker();
+    for (int i = 1; i < nworkers; ++i) {
+      threads.emplace_back(&thread_pool::worker_main, this, i);
+    }
+  }
+
+  ~thread_pool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+      generation++;
+    }
+    wakeup.notify_all();
+    for (auto& th : threads) th.join();
+    for (int i = 0; i < nworkers; ++i) workers[i].~worker();
+    free(workers);
+  }
+
+  int64_t reduce(int nthreads, size_t n, size_t grain, range_fn fn) override {
+    const size_t nchunks = (n + grain - 1) / grain;
+    const int nth = std::max(1, std::min(nthreads, nworkers));
+    job_start = std::chrono::steady_clock::now();
+    for (int i = 0; i < nth; ++i) {
+      uint64_t c0 = nchunks * i / nth;
+      uint64_t c1 = nchunks * (i + 1) / nth;
+      workers[i].range.store((c0 << 32) | c1, std::memory_order_relaxed);
+    }
+    job_n = n;
+    job_grain = grain;
+    job_fn = fn;
+    pending.store(nth - 1, std::memory_order_relaxed);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      active = nth;
+      if (nth > 1) generation++;
+    }
+    if (nth > 1) wakeup.notify_all();
+    work(0);
+    while (pending.load(std::memory_order_acquire) > 0) {
+      std::this_thread::yield();
+    }
+    int64_t total = 0;
+    double first = std::numeric_limits<double>::max();
+    double last = 0.0;
+    for (int i = 0; i < nth; ++i) {
+      total += workers[i].result;
+      stats.chunks += workers[i].chunks;
+      stats.steals += workers[i].steals;
+      first = std::min(first, workers[i].finish);
+      last = std::max(last, workers[i].finish);
+    }
+    stats.jobs++;
+    stats.duration += seconds_since(job_start);
+    stats.imbalance += last - first;
+    return total;
+  }
+
+  void print_stats() const override { stats.print(true); }
+
+private:
+  static uint32_t begin_of(uint64_t r) { return static_cast<uint32_t>(r >> 32); }
+  static uint32_t end_of(uint64_t r) { return static_cast<uint32_t>(r); }
+  static uint64_t pack(uint64_t b, uint64_t e) { return (b << 32) | e; }
+
+  void worker_main(int w) {
+    #ifdef __linux__
+      if (!cpus.empty()) {
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        CPU_SET(cpus[static_cast<size_t>(w) % cpus.size()], &mask);
+        sched_setaffinity(0, sizeof(mask), &mask);
+      }
+    #endif
+    uint64_t seen = 0;
+    while (true) {
+      // Spin briefly before going to sleep, since jobs usually come in quick
+      // succession.
+      for (int spin = 0; generation.load() == seen; ++spin) {
+        if (spin < 1000) {
+          std::this_thread::yield();
+        } else {
+          std::unique_lock<std::mutex> lock(mutex);
+          wakeup.wait(lock, [&]{ return generation.load() != seen; });
+        }
+      }
+      // Take the generation and the job parameters together: a worker that
+      // is part of a job is waited for, so no later job can be published
+      // before it has taken this one.
+      int job_active;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        seen = generation.load();
+        job_active = active;
+        if (stopping) return;
+      }
+      if (w < job_active) {
+        work(w);
+        pending.fetch_sub(1, std::memory_order_release);
+      }
+    }
+  }
+
+  void work(int w) {
+    worker& me = workers[w];
+    int64_t subtotal = 0;
+    size_t chunks = 0, steals = 0;
+    uint64_t c;
+    while (true) {
+      if (!pop(me, &c)) {
+        if (!steal(w, &c)) break;
+        steals++;
+      }
+      size_t i0 = c * job_grain;
+      subtotal += job_fn(i0, std::min(job_n, i0 + job_grain));
+      chunks++;
+    }
+    me.result = subtotal;
+    me.chunks = chunks;
+    me.steals = steals;
+    me.finish = seconds_since(job_start);
+  }
+
+  static bool pop(worker& me, uint64_t* c) {
+    uint64_t r = me.range.load(std::memory_order_relaxed);
+    while (begin_of(r) < end_of(r)) {
+      if (me.range.compare_exchange_weak(r, pack(begin_of(r) + 1, end_of(r)))) {
+        *c = begin_of(r);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Steals the back half of the first non-empty range among the other active
+  // workers: the first stolen chunk is returned in `c`, and the rest becomes
+  // the thief's own range (where it can in turn be stolen from).
+  bool steal(int w, uint64_t* c) {
+    for (int k = 1; k < active; ++k) {
+      worker& victim = workers[(w + k) % active];
+      uint64_t r = victim.range.load(std::memory_order_relaxed);
+      while (begin_of(r) < end_of(r)) {
+        uint64_t b = begin_of(r), e = end_of(r);
+        uint64_t mid = e - (e - b + 1) / 2;
+        if (victim.range.compare_exchange_weak(r, pack(b, mid))) {
+          *c = mid;
+          workers[w].range.store(pack(mid + 1, e));
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+};
+
+
+//------------------------------------------------------------------------------
+// Hardware performance counters
+//------------------------------------------------------------------------------
+
+// Thin wrapper around Linux `perf_event_open()`. The counters are opened once,
+// before the OMP thread pool is spawned, with the `inherit` flag so that the
+// events from the worker threads are folded into the counts read from the
+// main thread. Each event is opened separately: if the kernel or the hardware
+// refuses some of them (VMs, `perf_event_paranoid`, non-Linux systems), only
+// those are reported as "n/a", and if none can be opened the whole report is
+// skipped.
+struct perf_counters {
+  enum event {
+    CYCLES, INSTRUCTIONS, BRANCH_MISSES, L1D_MISSES, LLC_MISSES,
+    STALLED_CYCLES, N_EVENTS
+  };
+  int fds[N_EVENTS];
+  double counts[N_EVENTS];    // accumulated between `clear()` and now
+  uint64_t last[N_EVENTS][3]; // {value, time_enabled, time_running}
+
+  perf_counters() {
+    for (int i = 0; i < N_EVENTS; ++i) fds[i] = -1;
+    clear();
+  }
+
+  ~perf_counters() {
+    #ifdef __linux__
+      for (int i = 0; i < N_EVENTS; ++i) {
+        if (fds[i] >= 0) close(fds[i]);
+      }
+    #endif
+  }
+
+  bool open() {
+    #ifdef __linux__
+      const uint64_t l1d_read_miss =
+          PERF_COUNT_HW_CACHE_L1D |
+          (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+      const uint64_t ll_read_miss =
+          PERF_COUNT_HW_CACHE_LL |
+          (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+      fds[CYCLES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+      fds[INSTRUCTIONS] = open_event(PERF_TYPE_HARDWARE,
+                                     PERF_COUNT_HW_INSTRUCTIONS);
+      fds[BRANCH_MISSES] = open_event(PERF_TYPE_HARDWARE,
+                                      PERF_COUNT_HW_BRANCH_MISSES);
+      fds[L1D_MISSES] = open_event(PERF_TYPE_HW_CACHE, l1d_read_miss);
+      fds[LLC_MISSES] = open_event(PERF_TYPE_HW_CACHE, ll_read_miss);
+      if (fds[LLC_MISSES] < 0) {
+        fds[LLC_MISSES] = open_event(PERF_TYPE_HARDWARE,
+                                     PERF_COUNT_HW_CACHE_MISSES);
+      }
+      // Most Intel CPUs do not expose a generic "backend stalls" event, in
+      // which case fall back to the frontend ones.
+      fds[STALLED_CYCLES] = open_event(PERF_TYPE_HARDWARE,
+                                       PERF_COUNT_HW_STALLED_CYCLES_BACKEND);
+      if (fds[STALLED_CYCLES] < 0) {
+        fds[STALLED_CYCLES] = open_event(PERF_TYPE_HARDWARE,
+                                         PERF_COUNT_HW_STALLED_CYCLES_FRONTEND);
+      }
+    #endif
+    return available();
+  }
+
+  bool available() const {
+    for (int i = 0; i < N_EVENTS; ++i) {
+      if (fds[i] >= 0) return true;
+    }
+    return false;
+  }
+
+  bool has(event e) const { return fds[e] >= 0; }
+
+  void clear() {
+    for (int i = 0; i < N_EVENTS; ++i) counts[i] = 0.0;
+  }
+
+  // Counters run continuously; `start()` / `stop()` merely take snapshots,
+  // and the difference (scaled for multiplexing) is added into `counts`.
+  void start() {
+    for (int i = 0; i < N_EVENTS; ++i) {
+      if (fds[i] >= 0) read_event(i, last[i]);
+    }
+  }
+
+  void stop() {
+    for (int i = 0; i < N_EVENTS; ++i) {
+      if (fds[i] < 0) continue;
+      uint64_t now[3];
+      read_event(i, now);
+      double value = static_cast<double>(now[0] - last[i][0]);
+      uint64_t enabled = now[1] - last[i][1];
+      uint64_t running = now[2] - last[i][2];
+      if (running && running < enabled) {
+        value *= static_cast<double>(enabled) / static_cast<double>(running);
+      }
+      counts[i] += value;
+    }
+  }
+
+  // Print the summary for a task that processed `nelems` elements in total.
+  void report(double nelems) const {
+    std::cout << "    ";
+    if (has(CYCLES) && has(INSTRUCTIONS) && counts[CYCLES] > 0) {
+      printf("IPC %.2f", counts[INSTRUCTIONS] / counts[CYCLES]);
+    } else {
+      printf("IPC n/a");
+    }
+    print_ratio(", br-miss/elem ", BRANCH_MISSES, nelems);
+    print_ratio(", L1d-miss/elem ", L1D_MISSES, nelems);
+    print_ratio(", LLC-miss/elem ", LLC_MISSES, nelems);
+    if (has(STALLED_CYCLES) && has(CYCLES) && counts[CYCLES] > 0) {
+      printf(", stalled %.1f%%",
+             100.0 * counts[STALLED_CYCLES] / counts[CYCLES]);
+    } else {
+      printf(", stalled n/a");
+    }
+    printf("\n");
+  }
+
+private:
+  void print_ratio(const char* label, event e, double nelems) const {
+    if (has(e)) {
+      printf("%s%.4f", label, counts[e] / nelems);
+    } else {
+      printf("%sn/a", label);
+    }
+  }
+
+  #ifdef __linux__
+    static int open_event(uint32_t type, uint64_t config) {
+      struct perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = type;
+      attr.config = config;
+      attr.inherit = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                         PERF_FORMAT_TOTAL_TIME_RUNNING;
+      long fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+      return static_cast<int>(fd);
+    }
+  #endif
+
+  void read_event(int i, uint64_t* out) const {
+    out[0] = out[1] = out[2] = 0;
+    #ifdef __linux__
+      ssize_t ret = read(fds[i], out, 3 * sizeof(uint64_t));
+      (void) ret;
+    #endif
+  }
+};
+
+
+// Measurement settings shared by all tasks, set up in `main()`.
+struct run_context {
+  perf_counters* perf = nullptr;
+  // Attainable read bandwidth (bytes/s) for single-threaded and for parallel
+  // tasks, as measured by the reference tasks. Zero if not yet known.
+  double peak_bandwidth1 = 0.0;
+  double peak_bandwidthN = 0.0;
+  // Number of `run_once()` calls per timed sample.
+  int reps = 1;
+  // If set, the caches are flushed before every `run_once()`.
+  cache_flusher* flusher = nullptr;
+  // If set, successive `run_once()` calls take their input from this
+  // rotation instead of the input passed to `measure()`; the task is
+  // prepared for all of them before the timed runs.
+  input_rotation* rotation = nullptr;
+  // Executors for the chunked parallel tasks, and their chunk size.
+  executor* pool = nullptr;
+  executor* omp = nullptr;
+  size_t grain = 16384;
+  // Which executors run the chunked tasks: "pool", "omp", or "both".
+  std::string executors = "both";
+};
+
+
+struct task {
+  static constexpr int n_iterations = 100;
+  const std::string task_name;
+  int64_t total;
+
+  task(const std::string& name) : task_name(name), total(0) {}
+  virtual ~task() {}
+
+  virtual void run_once(const input_data& data) = 0;
+
+  // Number of input bytes the task reads per element of the vector; this is
+  // used to convert timings into memory bandwidth.
+  virtual double bytes_per_element() const { return sizeof(T); }
+
+  // Number of threads used by the task.
+  virtual int threads() const { return 1; }
+
+  // Tasks that collect additional statistics during their runs reset them
+  // at the start of `measure()`, and print them at the end of `run()`.
+  virtual void reset_stats() {}
+  virtual void print_stats() const {}
+
+  // Called at the start of `measure()`, outside of the timed region; tasks
+  // that produce output allocate their output buffers here.
+  virtual void prepare(const input_data&) {}
+
+  // Runs the task `n_iterations` times and returns the mean time of a single
+  // `run_once()` (in seconds); the standard deviation is stored into `stdev`.
+  // Each timed sample consists of `ctx.reps` consecutive runs, which keeps
+  // the timer overhead negligible when the input is small (with rotated
+  // inputs, a sample runs through successive inputs of the rotation). In
+  // cold-cache mode the runs are timed individually instead, since the input
+  // buffers must be evicted (outside of the timed region) before each of them.
+  double measure(const input_data& data, run_context& ctx, double* stdev) {
+    std::vector<double> times;
+    const int reps = ctx.reps;
+    perf_counters* perf = ctx.perf;
+    cache_flusher* flusher = ctx.flusher;
+    input_rotation* rotation = ctx.rotation;
+    prepare(data);
+    if (rotation) {
+      for (auto& input : rotation->inputs) prepare(*input);
+    }
+    if (perf) perf->clear();
+    reset_stats();
+    for (int i = 0; i < n_iterations; ++i) {
+      double elapsed = 0.0;
+      int batch = flusher? 1 : reps;
+      for (int j = 0; j < reps; j += batch) {
+        // In cold mode the batch is a single run, whose input is picked (and
+        // evicted) before the timer starts.
+        const input_data* cold_input = nullptr;
+        if (flusher) {
+          cold_input = rotation? &rotation->next() : &data;
+          flusher->flush(*cold_input);
+        }
+        if (perf) perf->start();
+        auto time0 = std::chrono::high_resolution_clock::now();
+        for (int k = 0; k < batch; ++k) {
+          run_once(cold_input? *cold_input :
+                   rotation? rotation->next() : data);
+        }
+        auto time1 = std::chrono::high_resolution_clock::now();
+        if (perf) perf->stop();
+        std::chrono::duration<double> diff = time1 - time0;
+        elapsed += diff.count();
+      }
+      times.push_back(elapsed / reps);  // store the time in seconds
+    }
+    double mean_time = 0.0;
+    for (auto& t : times) mean_time += t;
+    mean_time /= n_iterations;
+    double msd = 0.0;
+    for (auto& t : times) msd += (t - mean_time) * (t - mean_time);
+    msd /= n_iterations - 1;
+    if (stdev) *stdev = std::sqrt(msd);
+    return mean_time;
+  }
+
+  // Same as `measure()`, but also prints the summary.
+  double run(const input_data& data, run_context& ctx) {
+    double stdev;
+    double mean_time = measure(data, ctx, &stdev);
+    std::cout << task_name << ": ";
+    for (size_t i = task_name.size(); i < 30; ++i) std::cout << ' ';
+    std::cout << mean_time << " s,  +/- " << stdev << " s";
+    double bpe = bytes_per_element();
+    double bandwidth = bpe * static_cast<double>(data.n) / mean_time;
+    double peak = threads() == 1? ctx.peak_bandwidth1 : ctx.peak_bandwidthN;
+    printf(",  %.3f B/elem, %.2f GB/s", bpe, bandwidth * 1e-9);
+    if (peak > 0) printf(" (%.0f%% of peak)", 100.0 * bandwidth / peak);
+    printf("\n");
+    if (perf_counters* perf = ctx.perf) {
+      perf->report(static_cast<double>(data.n) * n_iterations * ctx.reps);
+    }
+    print_stats();
+    return mean_time;
+  }
+};
+
+
+struct parallel_task : public task {
+  int nthreads;
+
+  parallel_task(const std::string& name, int nth)
+    : task(name), nthreads(nth) {}
+
+  int threads() const override { return nthreads; }
+};
+
+
+// Parallel task that runs on one of the chunked executors; its name is the
+// name of the method followed by the name of the executor.
+struct chunked_task : public parallel_task {
+  executor& exec;
+  size_t grain;
+
+  chunked_task(const std::string& name, executor& ex, int nth, size_t gr)
+    : parallel_task(name + "_" + ex.name, nth), exec(ex), grain(gr) {}
+
+  void reset_stats() override { exec.stats.clear(); }
+  void print_stats() const override { exec.print_stats(); }
+};
+
+
+// Bytes per element read by the tasks that use both the data vector and the
+// validity bitmap.
+constexpr double bitmask_bytes_per_element = sizeof(T) + 1.0 / 8;
+
+
+// Reads a column file in batches of `batch` rows with `pread()`, and feeds
+// each batch (as an `input_data` view) to the `run_once()` of a task. Reading
+// happens on a separate thread into two alternating slots, so that the next
+// batch is read while the current one is being processed. The validity
+// bitmap is only read for tasks that use it.
+struct column_stream {
+  struct slot {
+    buffer<T> values;
+    buffer<uint8_t> bitmap;
+    size_t n;
+    bool full;
+  };
+
+  std::string path;
+  int fd;
+  column_header hdr;
+  size_t batch;
+  slot slots[2];
+  std::mutex mutex;
+  std::condition_variable cv;
+
+  column_stream(const std::string& path_, size_t batch_)
+    : path(path_), batch(std::max(batch_ / 64 * 64, size_t(64)))
+  {
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Cannot open file " + path);
+    struct stat st;
+    char head[sizeof(column_header)];
+    ssize_t nread = pread(fd, head, sizeof(head), 0);
+    if (fstat(fd, &st) != 0 || nread != static_cast<ssize_t>(sizeof(head))) {
+      ::close(fd);
+      throw std::runtime_error("File " + path + " is not a column file");
+    }
+    try {
+      hdr.read(head, static_cast<size_t>(st.st_size), path);
+    } catch (...) {
+      ::close(fd);
+      throw;
+    }
+    for (slot& s : slots) {
+      s.values.allocate(batch);
+      s.bitmap.allocate(batch / 8);
+    }
+  }
+
+  ~column_stream() { ::close(fd); }
+
+  size_t n() const { return hdr.n; }
+
+  // Streams the whole column through `tsk`, returns the elapsed time.
+  double run(task& tsk, bool with_bitmap) {
+    const size_t nbatches = (hdr.n + batch - 1) / batch;
+    for (slot& s : slots) s.full = false;
+    bool failed = false, stopping = false;
+    auto time0 = std::chrono::steady_clock::now();
+    std::thread reader([&]() {
+      for (size_t k = 0; k < nbatches; ++k) {
+        slot& s = slots[k % 2];
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          cv.wait(lock, [&]{ return !s.full || stopping; });
+          if (stopping || failed) return;
+        }
+        size_t i0 = k * batch;
+        size_t m = std::min(batch, hdr.n - i0);
+        bool ok = read_fully(s.values.data(), m * sizeof(T),
+                             hdr.values_offset + i0 * sizeof(T));
+        if (with_bitmap) {
+          ok = ok && read_fully(s.bitmap.data(), (m + 7) / 8,
+                                hdr.bitmap_offset + i0 / 8);
+        }
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          s.n = m;
+          s.full = true;
+          if (!ok) failed = true;
+        }
+        cv.notify_all();
+      }
+    });
+    {
+      // Stops and joins the reader when leaving this block, also when the
+      // task throws.
+      struct reader_guard {
+        column_stream& stream;
+        std::thread& reader;
+        bool& stopping;
+
+        ~reader_guard() {
+          {
+            std::lock_guard<std::mutex> lock(stream.mutex);
+            stopping = true;
+          }
+          stream.cv.notify_all();
+          reader.join();
+        }
+      } guard{*this, reader, stopping};
+
+      input_data view(0);
+      for (size_t k = 0; k < nbatches; ++k) {
+        slot& s = slots[k % 2];
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          cv.wait(lock, [&]{ return s.full || failed; });
+          if (failed) break;
+        }
+        view.n = s.n;
+        view.data.view(s.values.data(), s.n);
+        view.namask.view(s.bitmap.data(), (s.n + 7) / 8);
+        view.invalidate_stats();
+        tsk.run_once(view);
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          s.full = false;
+        }
+        cv.notify_all();
+      }
+    }
+    if (failed) throw std::runtime_error("Failed to read " + path);
+    return executor::seconds_since(time0);
+  }
+
+private:
+  bool read_fully(void* dest, size_t size, size_t offset) {
+    char* p = static_cast<char*>(dest);
+    while (size) {
+      ssize_t ret = pread(fd, p, size, static_cast<off_t>(offset));
+      if (ret <= 0) return false;
+      p += ret;
+      offset += static_cast<size_t>(ret);
+      size -= static_cast<size_t>(ret);
+    }
+    return true;
+  }
+};
+
+
+
+//------------------------------------------------------------------------------
+// Reference tasks
+//------------------------------------------------------------------------------
+
+// STREAM-like "read bandwidth" kernels: they touch exactly the same memory as
+// the NA-aware tasks, but do as little computation as possible, with several
+// independent accumulators, so that only the loads limit their rate. Their
+// best timings serve as the roof against which all other tasks are reported.
+
+// Reads `n` values with four independent 128-bit accumulators of wrapping
+// 32-bit adds (four scalar accumulators without SSE2); the result only keeps
+// the loads from being optimized away.
+static int64_t read_values(const T* x, size_t n) {
+  size_t i = 0;
+  int64_t sum = 0;
+  #ifdef __SSE2__
+    __m128i acc0 = _mm_setzero_si128(), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+    for (; i + 16 <= n; i += 16) {
+      const __m128i* v = reinterpret_cast<const __m128i*>(x + i);
+      acc0 = _mm_add_epi32(acc0, _mm_loadu_si128(v));
+      acc1 = _mm_add_epi32(acc1, _mm_loadu_si128(v + 1));
+      acc2 = _mm_add_epi32(acc2, _mm_loadu_si128(v + 2));
+      acc3 = _mm_add_epi32(acc3, _mm_loadu_si128(v + 3));
+    }
+    __m128i acc = _mm_add_epi32(_mm_add_epi32(acc0, acc1),
+                                _mm_add_epi32(acc2, acc3));
+    int32_t lanes[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+    sum = int64_t(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+  #else
+    int64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    for (; i + 4 <= n; i += 4) {
+      s0 += x[i];
+      s1 += x[i + 1];
+      s2 += x[i + 2];
+      s3 += x[i + 3];
+    }
+    sum = s0 + s1 + s2 + s3;
+  #endif
+  for (; i < n; ++i) sum += x[i];
+  return sum;
+}
+
+
+// Same for `n` bytes of a bitmap, summed with `psadbw`.
+static uint64_t read_bitmap(const uint8_t* p, size_t n) {
+  size_t i = 0;
+  uint64_t sum = 0;
+  #ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc0 = zero, acc1 = zero;
+    for (; i + 32 <= n; i += 32) {
+      const __m128i* v = reinterpret_cast<const __m128i*>(p + i);
+      acc0 = _mm_add_epi64(acc0, _mm_sad_epu8(_mm_loadu_si128(v), zero));
+      acc1 = _mm_add_epi64(acc1, _mm_sad_epu8(_mm_loadu_si128(v + 1), zero));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes),
+                     _mm_add_epi64(acc0, acc1));
+    sum = lanes[0] + lanes[1];
+  #endif
+  for (; i < n; ++i) sum += p[i];
+  return sum;
+}
+
+
+struct read_data : public task {
+  read_data() : task("read_data") {}
+
+  void run_once(const input_data& data) override {
+    total += read_values(data.data.data(), data.n);
+  }
+};
+
+
+struct read_data_namask : public task {
+  read_data_namask() : task("read_data_namask") {}
+
+  double bytes_per_element() const override {
+    return bitmask_bytes_per_element;
+  }
+
+  void run_once(const input_data& data) override {
+    uint64_t bits = read_bitmap(data.namask.data(), (data.n + 7) / 8);
+    total += read_values(data.data.data(), data.n) + static_cast<int64_t>(bits);
+  }
+};
+
+
+// The parallel variants give each thread one contiguous slice of the values
+// (and the corresponding bytes of the bitmap).
+struct read_data_omp : public parallel_task {
+  read_data_omp(int nth) : parallel_task("read_data_omp", nth) {}
+
+  void run_once(const input_data& data) override {
+    const size_t n = data.n;
+    const T* x = data.data.data();
+    int64_t sum = 0;
+    #pragma omp parallel num_threads(nthreads) reduction(+:sum)
+    {
+      size_t nth = static_cast<size_t>(omp_get_num_threads());
+      size_t ith = static_cast<size_t>(omp_get_thread_num());
+      size_t i0 = n * ith / nth, i1 = n * (ith + 1) / nth;
+      sum += read_values(x + i0, i1 - i0);
+    }
+    total += sum;
+  }
+};
+
+
+struct read_data_namask_omp : public parallel_task {
+  read_data_namask_omp(int nth) : parallel_task("read_data_namask_omp", nth) {}
+
+  double bytes_per_element() const override {
+    return bitmask_bytes_per_element;
+  }
+
+  void run_once(const input_data& data) override {
+    const size_t n = data.n;
+    const size_t nbytes = (n + 7) / 8;
+    const T* x = data.data.data();
+    const uint8_t* valid_bitmap = data.namask.data();
+    int64_t sum = 0;
+    #pragma omp parallel num_threads(nthreads) reduction(+:sum)
+    {
+      size_t nth = static_cast<size_t>(omp_get_num_threads());
+      size_t ith = static_cast<size_t>(omp_get_thread_num());
+      size_t i0 = n * ith / nth, i1 = n * (ith + 1) / nth;
+      size_t b0 = nbytes * ith / nth, b1 = nbytes * (ith + 1) / nth;
+      sum += read_values(x + i0, i1 - i0) +
+             static_cast<int64_t>(read_bitmap(valid_bitmap + b0, b1 - b0));
+    }
+    total += sum;
+  }
+};
+
+
+struct read_data_chunked : public chunked_task {
+  read_data_chunked(executor& ex, int nth, size_t gr)
+    : chunked_task("read_data", ex, nth, gr) {}
+
+  void run_once(const input_data& data) override {
+    const T* x = data.data.data();
+    total += exec.parallel_reduce(nthreads, data.n, grain,
+      [=](size_t i0, size_t i1) {
+        return read_values(x + i0, i1 - i0);
+      });
+  }
+};
+
+
+
+//------------------------------------------------------------------------------
+// Main tasks
+//------------------------------------------------------------------------------
+
+// Each serial method is written as a static `kernel()` over a range of `n`
+// elements starting at `x`, and accumulates into `total`. The bitmap pointer
+// must correspond to `x`, i.e. the range must start on a multiple of 8
+// elements; this lets the parallel variants below reuse the same kernels
+// chunk by chunk.
+
+
+struct sum_ignore_nulls : public task {
+  sum_ignore_nulls() : task("sum_ignore_nulls") {}
+
+  void run_once(const input_data& data) override {
+    kernel(data.data.data(), data.namask.data(), data.n, total);
+  }
+
+  static void kernel(const T* x, const uint8_t*, size_t n, int64_t& total) {
+    for (size_t i = 0; i < n; ++i) {
+      total += x[i];
+    }
+  }
+};
+
+
+struct sum_ignore_nulls_batched : public task {
+  sum_ignore_nulls_batched() : task("sum_ignore_nulls_batched") {}
+
+  void run_once(const input_data& data) override {
+    kernel(data.data.data(), data.namask.data(), data.n, total);
+  }
+
+  static void kernel(const T* x, const uint8_t*, size_t n, int64_t& total) {
+    size_t batches = n / 8;
+    for (size_t i = 0; i < batches; ++i) {
+      total += x[0] + x[1] + x[2] + x[3] + x[4] + x[5] + x[6] + x[7];
+      x += 8;
+    }
+    for (size_t i = batches * 8; i < n; ++i) {
+      total += *x++;
+    }
+  }
+};
+
+
+struct sum_sentinel_nulls_if : public task {
+  sum_sentinel_nulls_if() : task("sum_sentinel_nulls_if") {}
+
+  void run_once(const input_data& data) override {
+    kernel(data.data.data(), data.namask.data(), data.n, total);
+  }
+
+  static void kernel(const T* x, const uint8_t*, size_t n, int64_t& total) {
+    constexpr T NA = std::numeric_limits<T>::min();
+    for (size_t i = 0; i < n; ++i) {
+      if (x[i] != NA) total += x[i];
+    }
+  }
+};
+
+
+struct sum_sentinel_nulls_mul : public task {
+  sum_sentinel_nulls_mul() : task("sum_sentinel_nulls_mul") {}
+
+  void run_once(const input_data& data) override {
+    kernel(data.data.data(), data.namask.data(), data.n, total);
+  }
+
+  static void kernel(const T* x, const uint8_t*, size_t n, int64_t& total) {
+    constexpr T NA = std::numeric_limits<T>::min();
+    for (size_t i = 0; i < n; ++i) {
+      total += x[i] * (x[i] != NA);
+    }
+  }
+};
+
+
+struct sum_sentinel_nulls_batched : public task {
+  sum_sentinel_nulls_batched() : task("sum_sentinel_nulls_batched") {}
+
+  void run_once(const input_data& data) override {
+    kernel(data.data.data(), data.namask.data(), data.n, total);
+  }
+
+  static void kernel(const T* x, const uint8_t*, size_t n, int64_t& total) {
+    constexpr T NA = std::numeric_limits<T>::min();
+    const size_t nbatches = n / 8;
+    for (size_t i = 0; i < nbatches; ++i) {
+      total += x[0] * (x[0] != NA) +
+               x[1] * (x[1] != NA) +
+               x[2] * (x[2] != NA) +
+               x[3] * (x[3] != NA) +
+               x[4] * (x[4] != NA) +
+               x[5] * (x[5] != NA) +
+               x[6] * (x[6] != NA) +
+               x[7] * (x[7] != NA);
+      x += 8;
+    }
+    for (size_t i = nbatches * 8; i < n; ++i) {
+      T val = *x++;
+      total += val * (val != NA);
+    }
+  }
+};
+
+
+struct sum_bitmask_nulls : public task {
+  sum_bitmask_nulls() : task("sum_bitmask_nulls") {}
+
+  double bytes_per_element() const override {
+    return bitmask_bytes_per_element;
+  }
+
+  void run_once(const input_data& data) override {
+    kernel(data.data.data(), data.namask.data(), data.n, total);
+  }
+
+  static void kernel(const T* x, const uint8_t* valid_bitmap, size_t n,
+                     int64_t& total) {
+    for (size_t i = 0; i < n; ++i) {
+      total += x[i] * ((valid_bitmap[i/8] >> (i & 7)) & 1);
+    }
+  }
+};
+
+
+struct sum_bitmask_nulls_batched : public task {
+  sum_bitmask_nulls_batched() : task("sum_bitmask_nulls_batched") {}
+
+  double bytes_per_element() const override {
+    return bitmask_bytes_per_element;
+  }
+
+  void run_once(const input_data& data) override {
+    kernel(data.data.data(), data.namask.data(), data.n, total);
+  }
+
+  static void kernel(const T* x, const uint8_t* valid_bitmap, size_t n,
+                     int64_t& total) {
+    const size_t nbatches = n / 8;
+    for (size_t i = 0; i < nbatches; ++i) {
+      uint8_t valid_byte = valid_bitmap[i];
+      total += x[0] * (valid_byte & 1) +
+               x[1] * ((valid_byte >> 1) & 1) +
+               x[2] * ((valid_byte >> 2) & 1) +
+               x[3] * ((valid_byte >> 3) & 1) +
+               x[4] * ((valid_byte >> 4) & 1) +
+               x[5] * ((valid_byte >> 5) & 1) +
+               x[6] * ((valid_byte >> 6) & 1) +
+               x[7] * ((valid_byte >> 7) & 1);
+      x += 8;
+    }
+    for (size_t i = nbatches * 8; i < n; ++i) {
+      T val = *x++;
+      total += val * ((valid_bitmap[i/8] >> (i & 7)) & 1);
+    }
+  }
+};
+
+
+struct sum_bitmask_nulls_shortcut : public task {
+  sum_bitmask_nulls_shortcut() : task("sum_bitmask_nulls_shortcut") {}
+
+  double bytes_per_element() const override {
+    return bitmask_bytes_per_element;
+  }
+
+  void run_once(const input_data& data) override {
+    kernel(data.data.data(), data.namask.data(), data.n, total);
+  }
+
+  static void kernel(const T* x, const uint8_t* valid_bitmap, size_t n,
+                     int64_t& total) {
+    const size_t nbatches = n / 8;
+    for (size_t i = 0; i < nbatches; ++i) {
+      uint8_t valid_byte = valid_bitmap[i];
+      if (valid_byte == 0xFF) {
+        total += x[0] + x[1] + x[2] + x[3] + x[4] +
+                 x[5] + x[6] + x[7];
+      } else {
+        total += x[0] * (valid_byte & 1) +
+                 x[1] * ((valid_byte >> 1) & 1) +
+                 x[2] * ((valid_byte >> 2) & 1) +
+                 x[3] * ((valid_byte >> 3) & 1) +
+                 x[4] * ((valid_byte >> 4) & 1) +
+                 x[5] * ((valid_byte >> 5) & 1) +
+                 x[6] * ((valid_byte >> 6) & 1) +
+                 x[7] * ((valid_byte >> 7) & 1);
+      }
+      x += 8;
+    }
+    for (size_t i = nbatches * 8; i < n; ++i) {
+      T val = *x++;
+      total += val * ((valid_bitmap[i/8] >> (i & 7)) & 1);
+    }
+  }
+};
+
+
+struct sum_sentinel_nulls_omp1 : public parallel_task {
+  sum_sentinel_nulls_omp1(int nth) : parallel_task("sum_sentinel_nulls_omp1", nth) {}
+
+  void run_once(const input_data& data) override {
+    constexpr T NA = std::numeric_limits<T>::min();
+    const size_t n = data.n;
+    const T* x = data.data.data();
+    #pragma omp parallel num_threads(nthreads)
+    {
+      size_t nth = static_cast<size_t>(omp_get_num_threads());
+      size_t ith = static_cast<size_t>(omp_get_thread_num());
+      int64_t subtotal = 0;
+      for (size_t i = ith; i < n; i += nth) {
+        subtotal += x[i] * (x[i] != NA);
+      }
+      #pragma omp atomic update
+      total += subtotal;
+    }
+  }
+};
+
+
+struct sum_sentinel_nulls_omp2 : public parallel_task {
+  sum_sentinel_nulls_omp2(int nth) : parallel_task("sum_sentinel_nulls_omp2", nth) {}
+
+  void run_once(const input_data& data) override {
+    constexpr T NA = std::numeric_limits<T>::min();
+    const size_t n = data.n;
+    const T* x = data.data.data();
+    #pragma omp parallel for reduction (+:total) num_threads(nthreads)
+    for (size_t i = 0; i < n; ++i) {
+      total += x[i] * (x[i] != NA);
+    }
+  }
+};
+
+
+struct sum_bitmask_nulls_omp2 : public parallel_task {
+  sum_bitmask_nulls_omp2(int nth) : parallel_task("sum_bitmask_nulls_omp2", nth) {}
+
+  double bytes_per_element() const override {
+    return bitmask_bytes_per_element;
+  }
+
+  void run_once(const input_data& data) override {
+    const size_t n = data.n;
+    const size_t nbatches = n / 8;
+    const T* x = data.data.data();
+    const uint8_t* valid_bitmap = data.namask.data();
+    #pragma omp parallel for reduction (+:total) num_threads(nthreads)
+    for (size_t i = 0; i < nbatches; ++i) {
+      uint8_t valid_byte = valid_bitmap[i];
+      const T* xx = x + (i << 3);
+      total += xx[0] * (valid_byte & 1) +
+               xx[1] * ((valid_byte >> 1) & 1) +
+               xx[2] * ((valid_byte >> 2) & 1) +
+               xx[3] * ((valid_byte >> 3) & 1) +
+               xx[4] * ((valid_byte >> 4) & 1) +
+               xx[5] * ((valid_byte >> 5) & 1) +
+               xx[6] * ((valid_byte >> 6) & 1) +
+               xx[7] * ((valid_byte >> 7) & 1);
+    }
+    for (size_t i = nbatches * 8; i < n; ++i) {
+      total += x[i] * ((valid_bitmap[i/8] >> (i & 7)) & 1);
+    }
+  }
+};
+
+
+
+// Sum of the rows `[i0, i1)` by `K::kernel()`, into a local subtotal. This is
+// the loop body of the chunked parallel variants below, and of their
+// single-chunk serial baseline `local_of`: unlike the serial methods, which
+// accumulate into the member `total` through a reference, a local subtotal
+// can be kept in a register, which changes the code the compiler generates.
+template <typename K>
+struct chunk_sum {
+  const T* x;
+  const uint8_t* valid_bitmap;
+
+  int64_t operator()(size_t i0, size_t i1) const {
+    int64_t subtotal = 0;
+    K::kernel(x + i0, valid_bitmap + i0/8, i1 - i0, subtotal);
+    return subtotal;
+  }
+};
+
+
+// Serial method `K` summed as a single chunk by `chunk_sum<K>`, i.e. by
+// exactly the code of one chunk of `parallel_of<K>`. This (and not `K`
+// itself) is the serial baseline of the parallel variants.
+template <typename K>
+struct local_of : public task {
+  double bpe;
+
+  local_of() : task(K().task_name + "_local"), bpe(K().bytes_per_element()) {}
+
+  double bytes_per_element() const override { return bpe; }
+
+  void run_once(const input_data& data) override {
+    total += chunk_sum<K>{data.data.data(), data.namask.data()}(0, data.n);
+  }
+};
+
+
+// Parallel counterpart of the serial method `K`: the vector is processed in
+// chunks by one of the chunked executors, each chunk being reduced by
+// `chunk_sum<K>`. The chunks are multiples of 64 elements, so that the serial
+// and the parallel variants of each method see exactly the same bitmap
+// alignment, and the tail of the vector is handled within the last chunk
+// rather than serially.
+template <typename K>
+struct parallel_of : public chunked_task {
+  double bpe;
+
+  parallel_of(executor& ex, int nth, size_t gr)
+    : chunked_task(K().task_name, ex, nth, gr),
+      bpe(K().bytes_per_element()) {}
+
+  double bytes_per_element() const override { return bpe; }
+
+  void run_once(const input_data& data) override {
+    total += exec.parallel_reduce(nthreads, data.n, grain,
+        chunk_sum<K>{data.data.data(), data.namask.data()});
+  }
+};
+
+
+
+// Generated kernels: the sums of the main tasks written once as a template
+// over the NA policy, the unroll factor `U` and the number `A` of independent
+// accumulators (the unrolled row `r` adds into accumulator `r % A`). Each
+// policy provides `add()`, which adds the value of row `i` (if valid) into an
+// accumulator; policies with `shortcut` set sum a group of `U` rows without
+// NA checks when all of their validity bits are set, and `handles_na` is
+// false for the policy that also sums whatever the NA slots hold. As in the
+// hand-written kernels, the bitmap pointer must correspond to `x`.
+
+struct na_ignore {
+  static const char* name() { return "ignore"; }
+  static constexpr bool uses_bitmap = false;
+  static constexpr bool handles_na = false;
+  static constexpr bool shortcut = false;
+
+  template <typename Acc>
+  static void add(Acc& acc, const T* x, const uint8_t*, size_t i) {
+    acc += x[i];
+  }
+};
+
+
+struct na_sentinel_if {
+  static const char* name() { return "sentinel_if"; }
+  static constexpr bool uses_bitmap = false;
+  static constexpr bool handles_na = true;
+  static constexpr bool shortcut = false;
+
+  template <typename Acc>
+  static void add(Acc& acc, const T* x, const uint8_t*, size_t i) {
+    if (x[i] != std::numeric_limits<T>::min()) acc += x[i];
+  }
+};
+
+
+struct na_sentinel_mul {
+  static const char* name() { return "sentinel_mul"; }
+  static constexpr bool uses_bitmap = false;
+  static constexpr bool handles_na = true;
+  static constexpr bool shortcut = false;
+
+  template <typename Acc>
+  static void add(Acc& acc, const T* x, const uint8_t*, size_t i) {
+    acc += x[i] * (x[i] != std::numeric_limits<T>::min());
+  }
+};
+
+
+// Masks the value with all-ones or all-zeros, as a SIMD blend would.
+struct na_sentinel_blend {
+  static const char* name() { return "sentinel_blend"; }
+  static constexpr bool uses_bitmap = false;
+  static constexpr bool handles_na = true;
+  static constexpr bool shortcut = false;
+
+  template <typename Acc>
+  static void add(Acc& acc, const T* x, const uint8_t*, size_t i) {
+    acc += x[i] & -static_cast<T>(x[i] != std::numeric_limits<T>::min());
+  }
+};
+
+
+struct na_bitmask_mul {
+  static const char* name() { return "bitmask_mul"; }
+  static constexpr bool uses_bitmap = true;
+  static constexpr bool handles_na = true;
+  static constexpr bool shortcut = false;
+
+  template <typename Acc>
+  static void add(Acc& acc, const T* x, const uint8_t* valid_bitmap,
+                  size_t i) {
+    acc += x[i] * ((valid_bitmap[i/8] >> (i & 7)) & 1);
+  }
+};
+
+
+struct na_bitmask_shortcut : public na_bitmask_mul {
+  static const char* name() { return "bitmask_shortcut"; }
+  static constexpr bool shortcut = true;
+};
+
+
+// Whether the `U` validity bits starting at row `i` (a multiple of `U`, which
+// is a power of two up to 32) are all set.
+template <int U>
+static bool group_all_valid(const uint8_t* valid_bitmap, size_t i) {
+  constexpr uint32_t mask = ~0u >> (32 - U);
+  uint32_t bits = 0;
+  if (U >= 8) {
+    memcpy(&bits, valid_bitmap + i/8, U / 8);
+  } else {
+    bits = valid_bitmap[i/8] >> (i & 7);
+  }
+  return (bits & mask) == mask;
+}
+
+
+// Adds the rows `i + R` to `i + U - 1`, fully unrolled, into accumulators of
+// type `Acc`.
+template <typename Policy, int U, int A, typename Acc, int R = 0>
+struct unrolled_rows {
+  static void add(Acc* acc, const T* x, const uint8_t* valid_bitmap,
+                  size_t i) {
+    Policy::add(acc[R % A], x, valid_bitmap, i + R);
+    unrolled_rows<Policy, U, A, Acc, R + 1>::add(acc, x, valid_bitmap, i);
+  }
+};
+
+template <typename Policy, int U, int A, typename Acc>
+struct unrolled_rows<Policy, U, A, Acc, U> {
+  static void add(Acc*, const T*, const uint8_t*, size_t) {}
+};
+
+
+template <typename Policy, int U, int A>
+struct generated_sum : public task {
+  generated_sum()
+    : task(std::string("gen_") + Policy::name() + "_u" + std::to_string(U) +
+           "_a" + std::to_string(A)) {}
+
+  double bytes_per_element() const override {
+    return Policy::uses_bitmap? bitmask_bytes_per_element : sizeof(T);
+  }
+
+  void run_once(const input_data& data) override {
+    kernel(data.data.data(), data.namask.data(), data.n, total);
+  }
+
+  static void kernel(const T* x, const uint8_t* valid_bitmap, size_t n,
+                     int64_t& total) {
+    int64_t acc[A] = {};
+    size_t i = 0;
+    for (; i + U <= n; i += U) {
+      if (Policy::shortcut && group_all_valid<U>(valid_bitmap, i)) {
+        unrolled_rows<na_ignore, U, A, int64_t>::add(acc, x, valid_bitmap, i);
+      } else {
+        unrolled_rows<Policy, U, A, int64_t>::add(acc, x, valid_bitmap, i);
+      }
+    }
+    for (; i < n; ++i) {
+      Policy::add(acc[0], x, valid_bitmap, i);
+    }
+    for (int a = 0; a < A; ++a) total += acc[a];
+  }
+};
+
+
+// Number of groups of rows that can be summed into 32-bit accumulators, each
+// receiving `per_group` values of magnitude at most `max_abs` per group,
+// before they must be widened; 0 if even one group might overflow.
+static size_t lane_period(int64_t max_abs, size_t per_group, size_t ngroups) {
+  const size_t all = std::max<size_t>(1, ngroups);
+  if (max_abs == 0) return all;
+  int64_t groups = std::numeric_limits<int32_t>::max() /
+                   (max_abs * static_cast<int64_t>(per_group));
+  return std::min(static_cast<size_t>(groups), all);
+}
+
+
+// Base of the kernels with 32-bit accumulators, through which callers can
+// tell whether `prepare()` found a widening period (0 if it did not).
+struct lanes_task : public task {
+  size_t period;
+
+  lanes_task(const std::string& name) : task(name), period(0) {}
+};
+
+
+// Generated kernel with 32-bit accumulators, which are widened into 64-bit
+// ones every `period` groups of `U` rows, as derived from the range of the
+// values in `prepare()`: of the valid values, or of all of them for
+// `na_ignore`, which also adds the sentinels in the NA slots. With 32-bit
+// accumulators a vectorized loop adds twice as many values per instruction.
+// If the values are too large even for one group (as with `na_ignore` and
+// any NA), the kernel falls back to the 64-bit `generated_sum`, and its
+// timings must not be reported as those of 32-bit lanes.
+template <typename Policy, int U, int A>
+struct generated_sum_lanes : public lanes_task {
+  generated_sum_lanes()
+    : lanes_task(generated_sum<Policy, U, A>().task_name + "_lanes32") {}
+
+  double bytes_per_element() const override {
+    return Policy::uses_bitmap? bitmask_bytes_per_element : sizeof(T);
+  }
+
+  void prepare(const input_data& data) override {
+    period = lane_period(data.range().max_abs(!Policy::handles_na),
+                         (U + A - 1) / A, data.n / U);
+  }
+
+  void run_once(const input_data& data) override {
+    kernel(data.data.data(), data.namask.data(), data.n, period, total);
+  }
+
+  static void kernel(const T* x, const uint8_t* valid_bitmap, size_t n,
+                     size_t period, int64_t& total) {
+    if (period == 0) {
+      generated_sum<Policy, U, A>::kernel(x, valid_bitmap, n, total);
+      return;
+    }
+    int64_t wide[A] = {};
+    const size_t ngroups = n / U;
+    for (size_t g0 = 0; g0 < ngroups; g0 += period) {
+      int32_t acc[A] = {};
+      const size_t gend = std::min(ngroups, g0 + period);
+      for (size_t i = g0 * U; i < gend * U; i += U) {
+        if (Policy::shortcut && group_all_valid<U>(valid_bitmap, i)) {
+          unrolled_rows<na_ignore, U, A, int32_t>::add(acc, x, valid_bitmap, i);
+        } else {
+          unrolled_rows<Policy, U, A, int32_t>::add(acc, x, valid_bitmap, i);
+        }
+      }
+      for (int a = 0; a < A; ++a) wide[a] += acc[a];
+    }
+    for (size_t i = ngroups * U; i < n; ++i) {
+      Policy::add(wide[0], x, valid_bitmap, i);
+    }
+    for (int a = 0; a < A; ++a) total += wide[a];
+  }
+};
+
+
+// Accumulator variants of a hand-written method, given by its NA policy and
+// unroll factor: 1, 2, 4 and 8 local accumulators (unrolling further where
+// the method has fewer rows per iteration than accumulators), then 32-bit
+// lane accumulators.
+template <typename Policy, int U>
+static void add_accumulator_tasks(std::vector<std::unique_ptr<task>>& tasks) {
+  tasks.emplace_back(new generated_sum<Policy, U, 1>);
+  tasks.emplace_back(new generated_sum<Policy, (U > 2? U : 2), 2>);
+  tasks.emplace_back(new generated_sum<Policy, (U > 4? U : 4), 4>);
+  tasks.emplace_back(new generated_sum<Policy, (U > 8? U : 8), 8>);
+  tasks.emplace_back(new generated_sum_lanes<Policy, U, 1>);
+}
+
+
+// Unroll factors and accumulator counts of the generated kernels (only the
+// combinations with `A <= U`).
+template <typename Policy, int U>
+static void add_generated_tasks(std::vector<std::unique_ptr<task>>& tasks) {
+  tasks.emplace_back(new generated_sum<Policy, U, 1>);
+  if (U >= 2) tasks.emplace_back(new generated_sum<Policy, U, 2>);
+  if (U >= 4) tasks.emplace_back(new generated_sum<Policy, U, 4>);
+  if (U >= 8) tasks.emplace_back(new generated_sum<Policy, U, 8>);
+}
+
+template <typename Policy>
+static void add_generated_tasks(std::vector<std::unique_ptr<task>>& tasks) {
+  add_generated_tasks<Policy, 1>(tasks);
+  add_generated_tasks<Policy, 2>(tasks);
+  add_generated_tasks<Policy, 4>(tasks);
+  add_generated_tasks<Policy, 8>(tasks);
+  add_generated_tasks<Policy, 16>(tasks);
+  add_generated_tasks<Policy, 32>(tasks);
+}
+
+
+
+// Serial method `K` preceded by a check of the cached column statistics: a
+// column without NAs is summed by the NA-unaware loop of `sum_ignore_nulls`
+// (not touching the bitmap at all), and a column of only NAs is not scanned.
+// Otherwise `K::kernel()` runs as usual.
+template <typename K>
+struct with_stats : public task {
+  double bpe;
+
+  with_stats() : task(K().task_name + "_stats"), bpe(0.0) {}
+
+  double bytes_per_element() const override { return bpe; }
+
+  void prepare(const input_data& data) override {
+    const column_stats& stats = data.stats();
+    bpe = stats.all_na()? 0.0 :
+          stats.all_valid()? sizeof(T) : K().bytes_per_element();
+  }
+
+  void run_once(const input_data& data) override {
+    const column_stats& stats = data.stats();
+    if (stats.all_na()) return;
+    if (stats.all_valid()) {
+      sum_ignore_nulls::kernel(data.data.data(), nullptr, data.n, total);
+    } else {
+      K::kernel(data.data.data(), data.namask.data(), data.n, total);
+    }
+  }
+};
+
+
+
+// Parallel counterpart of `with_stats<K>`: the statistics are checked once,
+// before the job is dispatched, and the chosen kernel then runs in chunks as
+// in `parallel_of`.
+template <typename K>
+struct parallel_with_stats : public chunked_task {
+  double bpe;
+
+  parallel_with_stats(executor& ex, int nth, size_t gr)
+    : chunked_task(K().task_name + "_stats", ex, nth, gr), bpe(0.0) {}
+
+  double bytes_per_element() const override { return bpe; }
+
+  void prepare(const input_data& data) override {
+    const column_stats& stats = data.stats();
+    bpe = stats.all_na()? 0.0 :
+          stats.all_valid()? sizeof(T) : K().bytes_per_element();
+  }
+
+  void run_once(const input_data& data) override {
+    const column_stats& stats = data.stats();
+    if (stats.all_na()) return;
+    const T* x = data.data.data();
+    if (stats.all_valid()) {
+      total += exec.parallel_reduce(nthreads, data.n, grain,
+          chunk_sum<sum_ignore_nulls>{x, data.namask.data()});
+    } else {
+      total += exec.parallel_reduce(nthreads, data.n, grain,
+          chunk_sum<K>{x, data.namask.data()});
+    }
+  }
+};
+
+
+//------------------------------------------------------------------------------
+// Zone-map tasks
+//------------------------------------------------------------------------------
+
+// Sum, count and min of the valid values, computed both directly from the
+// validity bitmap and block by block with the help of the zone map (see
+// `zone_map`). With a zone map, all-NA blocks are skipped, all-valid blocks
+// are processed by NA-unaware loops, and only the mixed blocks look at the
+// bitmap. For the min tasks `total` holds the minimum of the last run (the
+// largest value of T if there are no valid values).
+
+// Base of the tasks that consult the zone map. Their bytes per element are
+// what is actually read for the given input: the summaries, plus (if
+// `reads_values`) the values and the bitmap of the blocks that are not
+// skipped.
+struct zonemap_task : public task {
+  bool reads_values;
+  double bpe;
+
+  zonemap_task(const std::string& name, bool values)
+    : task(name), reads_values(values), bpe(0.0) {}
+
+  double bytes_per_element() const override { return bpe; }
+
+  void prepare(const input_data& data) override {
+    const zone_map& zones = data.zones();
+    double bytes = static_cast<double>(zones.storage_bytes());
+    for (size_t b = 0; reads_values && b < zones.blocks.size(); ++b) {
+      double len = static_cast<double>(
+          std::min(zone_map::block_size, data.n - b * zone_map::block_size));
+      uint8_t flags = zones.blocks[b].flags;
+      if (flags == zone_map::all_valid) {
+        bytes += len * sizeof(T);
+      } else if (!flags) {
+        bytes += len * bitmask_bytes_per_element;
+      }
+    }
+    bpe = data.n? bytes / static_cast<double>(data.n) : 0.0;
+  }
+};
+
+
+struct sum_bitmask_nulls_zonemap : public zonemap_task {
+  sum_bitmask_nulls_zonemap() : zonemap_task("sum_bitmask_nulls_zonemap", true) {}
+
+  void run_once(const input_data& data) override {
+    const T* x = data.data.data();
+    const uint8_t* valid_bitmap = data.namask.data();
+    const zone_map& zones = data.zones();
+    const size_t n = data.n;
+    for (size_t b = 0; b < zones.blocks.size(); ++b) {
+      size_t i0 = b * zone_map::block_size;
+      size_t len = std::min(zone_map::block_size, n - i0);
+      uint8_t flags = zones.blocks[b].flags;
+      if (flags == zone_map::all_na) continue;
+      if (flags == zone_map::all_valid) {
+        sum_ignore_nulls::kernel(x + i0, nullptr, len, total);
+      } else {
+        sum_bitmask_nulls_batched::kernel(x + i0, valid_bitmap + i0/8, len,
+                                          total);
+      }
+    }
+  }
+};
+
+
+struct count_bitmask_nulls : public task {
+  count_bitmask_nulls() : task("count_bitmask_nulls") {}
+
+  double bytes_per_element() const override { return 1.0 / 8; }
+
+  void run_once(const input_data& data) override {
+    const uint8_t* valid_bitmap = data.namask.data();
+    const size_t n = data.n;
+    const size_t nwords = n / 64;
+    for (size_t i = 0; i < nwords; ++i) {
+      uint64_t word;
+      memcpy(&word, valid_bitmap + i * 8, sizeof(word));
+      total += __builtin_popcountll(word);
+    }
+    for (size_t i = nwords * 64; i < n; ++i) {
+      total += (valid_bitmap[i/8] >> (i & 7)) & 1;
+    }
+  }
+};
+
+
+struct count_bitmask_nulls_zonemap : public zonemap_task {
+  count_bitmask_nulls_zonemap()
+    : zonemap_task("count_bitmask_nulls_zonemap", false) {}
+
+  void run_once(const input_data& data) override {
+    for (const zone_map::block& blk : data.zones().blocks) {
+      total += blk.valid_count;
+    }
+  }
+};
+
+
+struct min_bitmask_nulls : public task {
+  min_bitmask_nulls() : task("min_bitmask_nulls") {}
+
+  double bytes_per_element() const override {
+    return bitmask_bytes_per_element;
+  }
+
+  void run_once(const input_data& data) override {
+    T m = std::numeric_limits<T>::max();
+    kernel(data.data.data(), data.namask.data(), data.n, m);
+    total = m;
+  }
+
+  // Invalid values are replaced by the largest value of T before taking the
+  // minimum, which keeps the loop free of branches.
+  static void kernel(const T* x, const uint8_t* valid_bitmap, size_t n,
+                     T& m) {
+    constexpr T MAX = std::numeric_limits<T>::max();
+    for (size_t i = 0; i < n; ++i) {
+      T v = ((valid_bitmap[i/8] >> (i & 7)) & 1)? x[i] : MAX;
+      m = std::min(m, v);
+    }
+  }
+};
+
+
+struct min_bitmask_nulls_zonemap : public zonemap_task {
+  min_bitmask_nulls_zonemap() : zonemap_task("min_bitmask_nulls_zonemap", true) {}
+
+  void run_once(const input_data& data) override {
+    const T* x = data.data.data();
+    const uint8_t* valid_bitmap = data.namask.data();
+    const zone_map& zones = data.zones();
+    const size_t n = data.n;
+    T m = std::numeric_limits<T>::max();
+    for (size_t b = 0; b < zones.blocks.size(); ++b) {
+      size_t i0 = b * zone_map::block_size;
+      size_t len = std::min(zone_map::block_size, n - i0);
+      uint8_t flags = zones.blocks[b].flags;
+      if (flags == zone_map::all_na) continue;
+      if (flags == zone_map::all_valid) {
+        for (size_t i = i0; i < i0 + len; ++i) m = std::min(m, x[i]);
+      } else {
+        min_bitmask_nulls::kernel(x + i0, valid_bitmap + i0/8, len, m);
+      }
+    }
+    total = m;
+  }
+};
+
+
+
+//------------------------------------------------------------------------------
+// Sparse NA tasks
+//------------------------------------------------------------------------------
+
+// These tasks use the sparse encoding of the NAs (see `sparse_nas`): the sum
+// is computed by the NA-unaware loop over all values, and then the values at
+// the NA positions, gathered through the list, are subtracted. Since the
+// values stored in the NA slots need not be anything in particular, this
+// works with any content of these slots. The list is read in addition to the
+// values, plus one (most likely missed) cache line per NA.
+
+template <typename I>
+struct sum_sparse_nulls : public task {
+  double bpe;
+
+  sum_sparse_nulls()
+    : task(sizeof(I) == 4? "sum_sparse_nulls_u32" : "sum_sparse_nulls_u64"),
+      bpe(sizeof(T)) {}
+
+  double bytes_per_element() const override { return bpe; }
+
+  void prepare(const input_data& data) override {
+    const sparse_nas& nas = data.sparse();
+    bpe = sizeof(T);
+    if (data.n) bpe += double(nas.count()) * sizeof(I) / double(data.n);
+  }
+
+  void run_once(const input_data& data) override {
+    const sparse_nas& nas = data.sparse();
+    const I* na_pos = nas.positions<I>();
+    if (na_pos) {
+      kernel(data.data.data(), na_pos, nas.count(), data.n, total);
+    } else {  // positions do not fit into I
+      kernel(data.data.data(), nas.positions<uint64_t>(), nas.count(),
+             data.n, total);
+    }
+  }
+
+  template <typename J>
+  static void kernel(const T* x, const J* na_pos, size_t nna, size_t n,
+                     int64_t& total) {
+    int64_t sum = 0;
+    sum_ignore_nulls::kernel(x, nullptr, n, sum);
+    for (size_t k = 0; k < nna; ++k) {
+      sum -= x[na_pos[k]];
+    }
+    total += sum;
+  }
+};
+
+
+// Parallel counterpart of `sum_sparse_nulls<I>`: each chunk sums its values,
+// and subtracts the values at those NA positions that fall into the chunk
+// (found by binary search in the list).
+template <typename I>
+struct parallel_sum_sparse_nulls : public chunked_task {
+  double bpe;
+
+  parallel_sum_sparse_nulls(executor& ex, int nth, size_t gr)
+    : chunked_task(sum_sparse_nulls<I>().task_name, ex, nth, gr),
+      bpe(sizeof(T)) {}
+
+  double bytes_per_element() const override { return bpe; }
+
+  void prepare(const input_data& data) override {
+    const sparse_nas& nas = data.sparse();
+    bpe = sizeof(T);
+    if (data.n) bpe += double(nas.count()) * sizeof(I) / double(data.n);
+  }
+
+  void run_once(const input_data& data) override {
+    const sparse_nas& nas = data.sparse();
+    const I* na_pos = nas.positions<I>();
+    if (na_pos) {
+      total += reduce(data.data.data(), na_pos, nas.count(), data.n);
+    } else {
+      total += reduce(data.data.data(), nas.positions<uint64_t>(),
+                      nas.count(), data.n);
+    }
+  }
+
+private:
+  template <typename J>
+  int64_t reduce(const T* x, const J* na_pos, size_t nna, size_t n) {
+    return exec.parallel_reduce(nthreads, n, grain,
+      [=](size_t i0, size_t i1) {
+        const J* k0 = std::lower_bound(na_pos, na_pos + nna, J(i0));
+        const J* k1 = std::lower_bound(k0, na_pos + nna, J(i1));
+        int64_t subtotal = 0;
+        sum_ignore_nulls::kernel(x + i0, nullptr, i1 - i0, subtotal);
+        for (const J* k = k0; k < k1; ++k) subtotal -= x[*k];
+        return subtotal;
+      });
+  }
+};
+
+
+
+//------------------------------------------------------------------------------
+// Roaring tasks
+//------------------------------------------------------------------------------
+
+// These tasks use the roaring-style encoding of the NAs (see `roaring_nas`),
+// processing the vector chunk by chunk according to the container type of
+// each chunk. The "filter" tasks copy the valid values into a new vector
+// (dropping the NAs), and add the number of values copied to `total`; the
+// bitmask variant is given for comparison.
+
+// Base of the roaring tasks: their bytes per element are the values plus
+// the whole compressed encoding.
+struct roaring_task : public task {
+  bool reads_values;
+  double bpe;
+
+  roaring_task(const std::string& name, bool values)
+    : task(name), reads_values(values), bpe(0.0) {}
+
+  double bytes_per_element() const override { return bpe; }
+
+  void prepare(const input_data& data) override {
+    double bytes = static_cast<double>(data.roaring().storage_bytes());
+    bpe = (reads_values? sizeof(T) : 0) +
+          (data.n? bytes / static_cast<double>(data.n) : 0.0);
+  }
+};
+
+
+struct sum_roaring_nulls : public roaring_task {
+  sum_roaring_nulls() : roaring_task("sum_roaring_nulls", true) {}
+
+  void run_once(const input_data& data) override {
+    const roaring_nas& r = data.roaring();
+    const T* x = data.data.data();
+    for (size_t c = 0; c < r.containers.size(); ++c) {
+      const roaring_nas::container& cont = r.containers[c];
+      const size_t c0 = c * roaring_nas::chunk_size;
+      const size_t len = std::min(roaring_nas::chunk_size, data.n - c0);
+      const T* xc = x + c0;
+      switch (cont.type) {
+        case roaring_nas::none:
+          sum_ignore_nulls::kernel(xc, nullptr, len, total);
+          break;
+        case roaring_nas::array: {
+          const uint16_t* pos = r.arrays.data() + cont.offset;
+          int64_t sum = 0;
+          sum_ignore_nulls::kernel(xc, nullptr, len, sum);
+          for (uint32_t k = 0; k < cont.count; ++k) sum -= xc[pos[k]];
+          total += sum;
+          break;
+        }
+        case roaring_nas::bitmap: {
+          const uint64_t* words = r.bitmaps.data() + cont.offset;
+          for (size_t i0 = 0; i0 < len; i0 += 64) {
+            uint64_t na_bits = words[i0 / 64];
+            size_t iend = std::min(len, i0 + 64);
+            if (!na_bits) {
+              sum_ignore_nulls::kernel(xc + i0, nullptr, iend - i0, total);
+            } else if (~na_bits) {
+              for (size_t i = i0; i < iend; ++i) {
+                total += xc[i] * !((na_bits >> (i - i0)) & 1);
+              }
+            }
+          }
+          break;
+        }
+        case roaring_nas::run: {
+          // sum the gaps between the runs of NAs
+          const uint16_t* runs = r.runs.data() + cont.offset;
+          size_t i = 0;
+          for (uint32_t k = 0; k < cont.count; ++k) {
+            size_t start = runs[2*k];
+            sum_ignore_nulls::kernel(xc + i, nullptr, start - i, total);
+            i = start + runs[2*k + 1] + 1u;
+          }
+          sum_ignore_nulls::kernel(xc + i, nullptr, len - i, total);
+          break;
+        }
+      }
+    }
+  }
+};
+
+
+struct count_roaring_nulls : public roaring_task {
+  count_roaring_nulls() : roaring_task("count_roaring_nulls", false) {}
+
+  void run_once(const input_data& data) override {
+    const roaring_nas& r = data.roaring();
+    for (size_t c = 0; c < r.containers.size(); ++c) {
+      const roaring_nas::container& cont = r.containers[c];
+      const size_t len = std::min(roaring_nas::chunk_size,
+                                  data.n - c * roaring_nas::chunk_size);
+      int64_t nas = 0;
+      switch (cont.type) {
+        case roaring_nas::none: break;
+        case roaring_nas::array: nas = cont.count; break;
+        case roaring_nas::bitmap: {
+          const uint64_t* words = r.bitmaps.data() + cont.offset;
+          for (size_t w = 0; w < roaring_nas::chunk_size / 64; ++w) {
+            nas += __builtin_popcountll(words[w]);
+          }
+          break;
+        }
+        case roaring_nas::run: {
+          const uint16_t* runs = r.runs.data() + cont.offset;
+          for (uint32_t k = 0; k < cont.count; ++k) nas += runs[2*k + 1] + 1;
+          break;
+        }
+      }
+      total += static_cast<int64_t>(len) - nas;
+    }
+  }
+};
+
+
+// Base of the filter tasks, which write the valid values into `out`.
+struct filter_task : public task {
+  buffer<T> out;
+  double bpe;
+
+  filter_task(const std::string& name) : task(name), bpe(0.0) {}
+
+  double bytes_per_element() const override { return bpe; }
+
+  void prepare(const input_data& data) override {
+    if (out.size() != data.n) out.allocate(data.n, data.alloc);
+    // values read, plus valid values written
+    const column_stats& stats = data.stats();
+    bpe = sizeof(T);
+    if (data.n) bpe += sizeof(T) * double(data.n - stats.na_count) / double(data.n);
+  }
+};
+
+
+struct filter_bitmask_nulls : public filter_task {
+  filter_bitmask_nulls() : filter_task("filter_bitmask_nulls") {}
+
+  void prepare(const input_data& data) override {
+    filter_task::prepare(data);
+    bpe += 1.0 / 8;
+  }
+
+  void run_once(const input_data& data) override {
+    const T* x = data.data.data();
+    const uint8_t* valid_bitmap = data.namask.data();
+    T* o = out.data();
+    size_t k = 0;
+    const size_t n = data.n;
+    const size_t nbatches = n / 8;
+    for (size_t i = 0; i < nbatches; ++i) {
+      uint8_t valid_byte = valid_bitmap[i];
+      const T* xx = x + i * 8;
+      if (valid_byte == 0xFF) {
+        memcpy(o + k, xx, 8 * sizeof(T));
+        k += 8;
+      } else {
+        // branch-free compaction: always store, advance only if valid
+        for (int j = 0; j < 8; ++j) {
+          o[k] = xx[j];
+          k += (valid_byte >> j) & 1;
+        }
+      }
+    }
+    for (size_t i = nbatches * 8; i < n; ++i) {
+      o[k] = x[i];
+      k += (valid_bitmap[i/8] >> (i & 7)) & 1;
+    }
+    total += static_cast<int64_t>(k);
+  }
+};
+
+
+struct filter_roaring_nulls : public filter_task {
+  filter_roaring_nulls() : filter_task("filter_roaring_nulls") {}
+
+  void prepare(const input_data& data) override {
+    filter_task::prepare(data);
+    if (data.n) {
+      bpe += double(data.roaring().storage_bytes()) / double(data.n);
+    }
+  }
+
+  void run_once(const input_data& data) override {
+    const roaring_nas& r = data.roaring();
+    const T* x = data.data.data();
+    T* o = out.data();
+    size_t k = 0;
+    for (size_t c = 0; c < r.containers.size(); ++c) {
+      const roaring_nas::container& cont = r.containers[c];
+      const size_t c0 = c * roaring_nas::chunk_size;
+      const size_t len = std::min(roaring_nas::chunk_size, data.n - c0);
+      const T* xc = x + c0;
+      switch (cont.type) {
+        case roaring_nas::none:
+          memcpy(o + k, xc, len * sizeof(T));
+          k += len;
+          break;
+        case roaring_nas::array: {
+          // copy the segments between consecutive NAs
+          const uint16_t* pos = r.arrays.data() + cont.offset;
+          size_t i = 0;
+          for (uint32_t j = 0; j < cont.count; ++j) {
+            memcpy(o + k, xc + i, (pos[j] - i) * sizeof(T));
+            k += pos[j] - i;
+            i = pos[j] + 1u;
+          }
+          memcpy(o + k, xc + i, (len - i) * sizeof(T));
+          k += len - i;
+          break;
+        }
+        case roaring_nas::bitmap: {
+          const uint64_t* words = r.bitmaps.data() + cont.offset;
+          for (size_t i0 = 0; i0 < len; i0 += 64) {
+            uint64_t na_bits = words[i0 / 64];
+            size_t iend = std::min(len, i0 + 64);
+            for (size_t i = i0; i < iend; ++i) {
+              o[k] = xc[i];
+              k += !((na_bits >> (i - i0)) & 1);
+            }
+          }
+          break;
+        }
+        case roaring_nas::run: {
+          const uint16_t* runs = r.runs.data() + cont.offset;
+          size_t i = 0;
+          for (uint32_t j = 0; j < cont.count; ++j) {
+            size_t start = runs[2*j];
+            memcpy(o + k, xc + i, (start - i) * sizeof(T));
+            k += start - i;
+            i = start + runs[2*j + 1] + 1u;
+          }
+          memcpy(o + k, xc + i, (len - i) * sizeof(T));
+          k += len - i;
+          break;
+        }
+      }
+    }
+    total += static_cast<int64_t>(k);
+  }
+};
+
+
+
+//------------------------------------------------------------------------------
+// Compressed-execution tasks
+//------------------------------------------------------------------------------
+
+// Sum and count computed directly on the run-length encoding (`rle_column`)
+// and on the dictionary encoding (`dict_column`) of the column, without
+// decoding it. Their bytes per element are the size of the encoding divided
+// by `n`, so they depend on how repetitive the values are (`--value-run`).
+
+// Base of the tasks on an encoded column; `Enc` is `rle_column` or
+// `dict_column`.
+template <typename Enc>
+struct encoded_task : public task {
+  double bpe;
+
+  encoded_task(const std::string& name) : task(name), bpe(0.0) {}
+
+  double bytes_per_element() const override { return bpe; }
+
+  void prepare(const input_data& data) override {
+    const Enc& enc = encoding(data, static_cast<const Enc*>(nullptr));
+    bpe = data.n? double(enc.storage_bytes()) / double(data.n) : 0;
+  }
+
+private:
+  static const rle_column& encoding(const input_data& data, const rle_column*) {
+    return data.rle();
+  }
+  static const dict_column& encoding(const input_data& data, const dict_column*) {
+    return data.dictionary();
+  }
+};
+
+
+struct sum_rle_nulls : public encoded_task<rle_column> {
+  sum_rle_nulls() : encoded_task("sum_rle_nulls") {}
+
+  void run_once(const input_data& data) override {
+    const rle_column& rle = data.rle();
+    const T* values = rle.values.data();
+    const uint32_t* lengths = rle.lengths.data();
+    const size_t nruns = rle.values.size();
+    // NA runs have value 0, so they need no special handling
+    for (size_t k = 0; k < nruns; ++k) {
+      total += int64_t(values[k]) * (lengths[k] & rle_column::max_length);
+    }
+  }
+};
+
+
+struct count_rle_nulls : public encoded_task<rle_column> {
+  count_rle_nulls() : encoded_task("count_rle_nulls") {}
+
+  void run_once(const input_data& data) override {
+    const rle_column& rle = data.rle();
+    for (uint32_t len : rle.lengths) {
+      total += len & rle_column::max_length & -int32_t(!(len & rle_column::na_run));
+    }
+  }
+};
+
+
+// Decodes each code through the dictionary while summing. The NA code 0 maps
+// to the placeholder value 0, so NAs need no special handling.
+struct sum_dict_nulls : public encoded_task<dict_column> {
+  sum_dict_nulls() : encoded_task("sum_dict_nulls") {}
+
+  void run_once(const input_data& data) override {
+    const dict_column& d = data.dictionary();
+    if (d.code_bits == 8) kernel(d.dict.data(), d.codes8.data(), data.n, total);
+    if (d.code_bits == 16) kernel(d.dict.data(), d.codes16.data(), data.n, total);
+    if (d.code_bits == 32) kernel(d.dict.data(), d.codes32.data(), data.n, total);
+  }
+
+  // The sum is accumulated in a local variable: 8-bit codes may alias
+  // `total`, which would otherwise be reloaded and stored on every iteration.
+  template <typename C>
+  static void kernel(const T* dict, const C* codes, size_t n, int64_t& total) {
+    int64_t sum = 0;
+    for (size_t i = 0; i < n; ++i) {
+      sum += dict[codes[i]];
+    }
+    total += sum;
+  }
+};
+
+
+// Counts the occurrences of each code, and then sums the dictionary values
+// weighted by their counts. Four interleaved count tables are used, so that
+// runs of equal codes do not serialize on a single counter.
+struct sum_dict_nulls_histogram : public encoded_task<dict_column> {
+  std::vector<int64_t> counts;
+
+  sum_dict_nulls_histogram() : encoded_task("sum_dict_nulls_histogram") {}
+
+  // Sized for the largest dictionary of the inputs it is prepared for.
+  void prepare(const input_data& data) override {
+    encoded_task::prepare(data);
+    counts.resize(std::max(counts.size(), 4 * data.dictionary().dict.size()));
+  }
+
+  void run_once(const input_data& data) override {
+    const dict_column& d = data.dictionary();
+    const size_t ncodes = d.dict.size();
+    std::fill(counts.begin(), counts.begin() + 4 * ncodes, int64_t(0));
+    if (d.code_bits == 8) histogram(d.codes8.data(), data.n, ncodes);
+    if (d.code_bits == 16) histogram(d.codes16.data(), data.n, ncodes);
+    if (d.code_bits == 32) histogram(d.codes32.data(), data.n, ncodes);
+    for (size_t c = 1; c < ncodes; ++c) {
+      int64_t count = counts[c] + counts[ncodes + c] + counts[2 * ncodes + c] +
+                      counts[3 * ncodes + c];
+      total += d.dict[c] * count;
+    }
+  }
+
+  template <typename C>
+  void histogram(const C* codes, size_t n, size_t ncodes) {
+    int64_t* c0 = counts.data();
+    int64_t* c1 = c0 + ncodes;
+    int64_t* c2 = c1 + ncodes;
+    int64_t* c3 = c2 + ncodes;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+      c0[codes[i]]++;
+      c1[codes[i + 1]]++;
+      c2[codes[i + 2]]++;
+      c3[codes[i + 3]]++;
+    }
+    for (; i < n; ++i) c0[codes[i]]++;
+  }
+};
+
+
+struct count_dict_nulls : public encoded_task<dict_column> {
+  count_dict_nulls() : encoded_task("count_dict_nulls") {}
+
+  void run_once(const input_data& data) override {
+    const dict_column& d = data.dictionary();
+    if (d.code_bits == 8) kernel(d.codes8.data(), data.n, total);
+    if (d.code_bits == 16) kernel(d.codes16.data(), data.n, total);
+    if (d.code_bits == 32) kernel(d.codes32.data(), data.n, total);
+  }
+
+  template <typename C>
+  static void kernel(const C* codes, size_t n, int64_t& total) {
+    int64_t count = 0;
+    for (size_t i = 0; i < n; ++i) {
+      count += codes[i] != 0;
+    }
+    total += count;
+  }
+};
+
+
+
+//------------------------------------------------------------------------------
+// Bit-packed tasks
+//------------------------------------------------------------------------------
+
+// Sums computed on the bit-packed encodings (see `packed_column`): with NAs
+// stored as the all-ones code ("packed_sentinel"), or with NA slots holding
+// code 0 and the validity bitmap read alongside ("packed_bitmask"). The codes
+// of the valid values are summed, and `base` times the number of valid
+// values is added at the end. Kernels work on ranges of rows starting on a
+// block boundary, so that the parallel variants can reuse them.
+
+typedef void (*sum_packed_blocks_fn)(const uint32_t*, const uint8_t*, size_t,
+                                     int64_t&, int64_t&);
+
+// Unpacks and sums full blocks of codes with SSE2, for a compile-time bit
+// width `B`: each of the 32 rows of a block yields 4 codes with one or two
+// shifts (see `sum_packed_rows`), and the codes of the valid values are
+// accumulated in 32-bit lanes (with B <= 24 a block cannot overflow them),
+// which are widened once per block. With `Bitmask`, the validity of the 4
+// values of a row comes from a nibble of the bitmap; otherwise the values
+// equal to the NA code are excluded.
+#ifdef __SSE2__
+// Row `R` of a block: extracts 4 codes, and adds the valid ones to `acc` and
+// the number of valid (or NA) ones to `cnt`. The rows are unrolled through
+// recursion, so that all offsets and shift amounts are compile-time
+// constants, as in the generated kernels of BP128.
+template <int B, bool Bitmask, int R = 0>
+struct sum_packed_rows {
+  static constexpr int offset = R * B;
+  static constexpr int k = offset / 32;
+  static constexpr int shift = offset % 32;
+
+  static inline void run(const __m128i* w, const uint8_t* valid_bytes,
+                         __m128i na, __m128i bits, __m128i& acc, __m128i& cnt) {
+    __m128i v = _mm_srli_epi32(_mm_loadu_si128(w + k), shift);
+    if (shift + B > 32) {
+      // the shift amount is kept in range even for the rows not taking this
+      // branch, which still have to compile
+      v = _mm_or_si128(v, _mm_slli_epi32(_mm_loadu_si128(w + k + 1),
+                                         (32 - shift) & 31));
+    }
+    v = _mm_and_si128(v, na);
+    if (Bitmask) {
+      __m128i nibble = _mm_set1_epi32(valid_bytes[R / 2] >> ((R & 1) * 4));
+      __m128i valid = _mm_cmpeq_epi32(_mm_and_si128(nibble, bits), bits);
+      acc = _mm_add_epi32(acc, _mm_and_si128(valid, v));
+      cnt = _mm_sub_epi32(cnt, valid);
+    } else {
+      __m128i is_na = _mm_cmpeq_epi32(v, na);
+      acc = _mm_add_epi32(acc, _mm_andnot_si128(is_na, v));
+      cnt = _mm_sub_epi32(cnt, is_na);
+    }
+    sum_packed_rows<B, Bitmask, R + 1>::run(w, valid_bytes, na, bits, acc, cnt);
+  }
+};
+
+template <int B, bool Bitmask>
+struct sum_packed_rows<B, Bitmask, 32> {
+  static inline void run(const __m128i*, const uint8_t*, __m128i, __m128i,
+                         __m128i&, __m128i&) {}
+};
+
+
+template <int B, bool Bitmask>
+static void sum_packed_blocks(const uint32_t* words, const uint8_t* valid_bitmap,
+                              size_t nblocks, int64_t& code_sum,
+                              int64_t& count) {
+  const __m128i na = _mm_set1_epi32(int((uint32_t(1) << B) - 1));
+  const __m128i bits = _mm_setr_epi32(1, 2, 4, 8);
+  for (size_t blk = 0; blk < nblocks; ++blk) {
+    const __m128i* w = reinterpret_cast<const __m128i*>(words + blk * 4 * B);
+    __m128i acc = _mm_setzero_si128();
+    __m128i cnt = _mm_setzero_si128();
+    sum_packed_rows<B, Bitmask>::run(w, valid_bitmap + blk * 16, na, bits,
+                                     acc, cnt);
+    alignas(16) uint32_t a[4], c[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(a), acc);
+    _mm_store_si128(reinterpret_cast<__m128i*>(c), cnt);
+    code_sum += int64_t(a[0]) + a[1] + a[2] + a[3];
+    int64_t k = int64_t(c[0]) + c[1] + c[2] + c[3];
+    count += Bitmask? k : int64_t(packed_column::block_size) - k;
+  }
+}
+
+// Instance of `sum_packed_blocks` for bit width `width`, or null if the width
+// exceeds 24.
+template <bool Bitmask, int B = 24>
+struct sum_packed_blocks_table {
+  static sum_packed_blocks_fn get(int width) {
+    return width == B? &sum_packed_blocks<B, Bitmask>
+                     : sum_packed_blocks_table<Bitmask, B - 1>::get(width);
+  }
+};
+
+template <bool Bitmask>
+struct sum_packed_blocks_table<Bitmask, 0> {
+  static sum_packed_blocks_fn get(int) { return nullptr; }
+};
+#endif
+
+
+// Scalar unpacking of rows `[i0, i1)`, where `i0` is a multiple of the block
+// size. Codes are extracted row by row, 4 lanes per row, in the same order as
+// the SIMD kernel.
+template <bool Bitmask>
+static void sum_packed_scalar(const packed_column& pc, const uint8_t* valid_bitmap,
+                              size_t i0, size_t i1, int64_t& code_sum,
+                              int64_t& count) {
+  const size_t width = static_cast<size_t>(pc.width);
+  const uint32_t na = pc.na();
+  int64_t sum = 0, k = 0;
+  for (size_t b0 = i0; b0 < i1; b0 += packed_column::block_size) {
+    const uint32_t* w = pc.words.data() + (b0 / packed_column::block_size) * 4 * width;
+    const size_t len = std::min(packed_column::block_size, i1 - b0);
+    for (size_t j = 0; j < len; ++j) {
+      size_t lane = j % 4, offset = (j / 4) * width;
+      size_t word = offset / 32, shift = offset % 32;
+      uint64_t bits = w[word * 4 + lane] >> shift;
+      if (shift + width > 32) bits |= uint64_t(w[(word + 1) * 4 + lane]) << (32 - shift);
+      uint32_t code = static_cast<uint32_t>(bits) & na;
+      size_t i = b0 + j;
+      bool valid = Bitmask? (valid_bitmap[i/8] >> (i & 7)) & 1 : code != na;
+      sum += valid? code : 0;
+      k += valid;
+    }
+  }
+  code_sum += sum;
+  count += k;
+}
+
+
+template <bool Bitmask>
+struct sum_packed_nulls : public task {
+  double bpe;
+
+  sum_packed_nulls() : sum_packed_nulls("") {}
+
+  // Names the task after the encoding, followed by `suffix`.
+  sum_packed_nulls(const char* suffix)
+    : task(std::string(Bitmask? "sum_packed_bitmask_nulls"
+                              : "sum_packed_sentinel_nulls") + suffix),
+      bpe(0.0) {}
+
+  double bytes_per_element() const override { return bpe; }
+
+  void prepare(const input_data& data) override {
+    bpe = packed_bytes_per_element(data);
+  }
+
+  void run_once(const input_data& data) override {
+    kernel(data, 0, data.n, total);
+  }
+
+  static double packed_bytes_per_element(const input_data& data) {
+    if (!data.n) return 0.0;
+    const packed_column& pc = column(data);
+    return double(pc.storage_bytes()) / double(data.n) + (Bitmask? 1.0 / 8 : 0);
+  }
+
+  static const packed_column& column(const input_data& data) {
+    return Bitmask? data.packed_values() : data.packed_sentinel();
+  }
+
+  static void kernel(const input_data& data, size_t i0, size_t i1,
+                     int64_t& total) {
+    const packed_column& pc = column(data);
+    int64_t code_sum = 0, count = 0;
+    sum_packed_scalar<Bitmask>(pc, data.namask.data(), i0, i1, code_sum, count);
+    total += code_sum + count * pc.base;
+  }
+};
+
+
+template <bool Bitmask>
+struct sum_packed_nulls_simd : public sum_packed_nulls<Bitmask> {
+  sum_packed_nulls_simd() : sum_packed_nulls<Bitmask>("_simd") {}
+
+  void run_once(const input_data& data) override {
+    kernel(data, 0, data.n, this->total);
+  }
+
+  // Full blocks go through the SIMD kernel for the column's bit width (or
+  // the scalar one for widths over 24, or without SSE2); the partial last
+  // block is unpacked by the scalar kernel.
+  static void kernel(const input_data& data, size_t i0, size_t i1,
+                     int64_t& total) {
+    const packed_column& pc = sum_packed_nulls<Bitmask>::column(data);
+    const size_t block_size = packed_column::block_size;
+    const size_t nblocks = (i1 - i0) / block_size;
+    const size_t iend = i0 + nblocks * block_size;
+    int64_t code_sum = 0, count = 0;
+    sum_packed_blocks_fn fn = nullptr;
+    #ifdef __SSE2__
+      fn = sum_packed_blocks_table<Bitmask>::get(pc.width);
+    #endif
+    if (fn) {
+      fn(pc.words.data() + (i0 / block_size) * 4 * static_cast<size_t>(pc.width),
+         data.namask.data() + i0 / 8, nblocks, code_sum, count);
+    } else {
+      sum_packed_scalar<Bitmask>(pc, data.namask.data(), i0, iend, code_sum,
+                                 count);
+    }
+    sum_packed_scalar<Bitmask>(pc, data.namask.data(), iend, i1, code_sum,
+                               count);
+    total += code_sum + count * pc.base;
+  }
+};
+
+
+// Parallel counterpart of `sum_packed_nulls_simd`: the chunks are whole
+// numbers of blocks.
+template <bool Bitmask>
+struct parallel_sum_packed_nulls : public chunked_task {
+  double bpe;
+
+  parallel_sum_packed_nulls(executor& ex, int nth, size_t gr)
+    : chunked_task(sum_packed_nulls_simd<Bitmask>().task_name, ex, nth, gr),
+      bpe(0.0) {}
+
+  double bytes_per_element() const override { return bpe; }
+
+  void prepare(const input_data& data) override {
+    bpe = sum_packed_nulls<Bitmask>::packed_bytes_per_element(data);
+  }
+
+  void run_once(const input_data& data) override {
+    const size_t block_size = packed_column::block_size;
+    const size_t n = data.n;
+    const size_t nblocks = (n + block_size - 1) / block_size;
+    const input_data* d = &data;
+    total += exec.parallel_reduce(nthreads, nblocks,
+                                  std::max(size_t(1), grain / block_size),
+      [=](size_t b0, size_t b1) {
+        int64_t subtotal = 0;
+        sum_packed_nulls_simd<Bitmask>::kernel(
+            *d, b0 * block_size, std::min(n, b1 * block_size), subtotal);
+        return subtotal;
+      });
+  }
+};
+
+
+
+//------------------------------------------------------------------------------
+// Multi-aggregate tasks
+//------------------------------------------------------------------------------
+
+// Several aggregates of the valid values (sum, count, min, max, sum of
+// squares), computed for either NA encoding by kernels templated on the set
+// of aggregates `What`. Instantiated with a single aggregate they give the
+// individual kernels, and with `agg_all` the fused single-pass kernel, so that
+// the two are compared on the same code.
+
+constexpr unsigned agg_sum = 1;
+constexpr unsigned agg_count = 2;
+constexpr unsigned agg_min = 4;
+constexpr unsigned agg_max = 8;
+constexpr unsigned agg_sumsq = 16;
+constexpr unsigned agg_all = 31;
+
+struct aggregates {
+  int64_t sum = 0;
+  int64_t count = 0;
+  T min = std::numeric_limits<T>::max();
+  T max = std::numeric_limits<T>::min();
+  double sumsq = 0.0;
+
+  void merge(const aggregates& other) {
+    sum += other.sum;
+    count += other.count;
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+    sumsq += other.sumsq;
+  }
+
+  // Equality, up to rounding in the sum of squares (whose order of additions
+  // differs between the kernels).
+  bool matches(const aggregates& other) const {
+    return sum == other.sum && count == other.count && min == other.min &&
+           max == other.max &&
+           std::fabs(sumsq - other.sumsq) <= 1e-9 * std::fabs(other.sumsq);
+  }
+};
+
+
+// Scalar kernel over `n` elements starting at `x` (on a multiple of 8, as
+// for the summing methods). Invalid values are replaced by neutral elements
+// rather than branched around.
+template <bool Bitmask, unsigned What>
+static void aggregate_scalar(const T* x, const uint8_t* valid_bitmap, size_t n,
+                             aggregates& agg) {
+  constexpr T NA = std::numeric_limits<T>::min();
+  constexpr T MAX = std::numeric_limits<T>::max();
+  int64_t sum = 0, count = 0;
+  T mn = agg.min, mx = agg.max;
+  double sumsq = 0.0;
+  for (size_t i = 0; i < n; ++i) {
+    bool valid = Bitmask? (valid_bitmap[i/8] >> (i & 7)) & 1 : x[i] != NA;
+    T v = valid? x[i] : 0;
+    if (What & agg_sum) sum += v;
+    if (What & agg_count) count += valid;
+    if (What & agg_min) mn = std::min(mn, valid? v : MAX);
+    if (What & agg_max) mx = std::max(mx, valid? v : NA);
+    if (What & agg_sumsq) sumsq += double(v) * v;
+  }
+  agg.sum += sum;
+  agg.count += count;
+  agg.min = mn;
+  agg.max = mx;
+  agg.sumsq += sumsq;
+}
+
+
+// SSE2 kernel: 4 values per step. The validity lane mask comes from a nibble
+// of the bitmap, or from comparing with the sentinel; invalid lanes are
+// zeroed for the sum and the sum of squares, and replaced by the largest or
+// the smallest value of T for the min and the max (SSE2 has no 32-bit
+// min/max instructions, so these are compare-and-blend). The sum is widened
+// into two 64-bit lanes at every step, the count is kept in 32-bit lanes,
+// and the squares are accumulated as doubles.
+template <bool Bitmask, unsigned What>
+static void aggregate_simd(const T* x, const uint8_t* valid_bitmap, size_t n,
+                           aggregates& agg) {
+  size_t i = 0;
+  #ifdef __SSE2__
+    constexpr T NA = std::numeric_limits<T>::min();
+    constexpr T MAX = std::numeric_limits<T>::max();
+    const __m128i na = _mm_set1_epi32(NA);
+    const __m128i maxv = _mm_set1_epi32(MAX);
+    const __m128i bits = _mm_setr_epi32(1, 2, 4, 8);
+    const __m128i ones = _mm_set1_epi32(-1);
+    __m128i sum = _mm_setzero_si128();
+    __m128i cnt = _mm_setzero_si128();
+    __m128i mn = _mm_set1_epi32(agg.min);
+    __m128i mx = _mm_set1_epi32(agg.max);
+    __m128d sq0 = _mm_setzero_pd(), sq1 = _mm_setzero_pd();
+    // two nibbles per step, so that the scalar tail starts on a whole byte
+    for (; i + 8 <= n; i += 8) {
+      for (size_t h = 0; h < 8; h += 4) {
+        const __m128i* px = reinterpret_cast<const __m128i*>(x + i + h);
+        __m128i v = _mm_loadu_si128(px);
+        __m128i valid;
+        if (Bitmask) {
+          __m128i nibble = _mm_set1_epi32(valid_bitmap[i/8] >> h);
+          valid = _mm_cmpeq_epi32(_mm_and_si128(nibble, bits), bits);
+        } else {
+          valid = _mm_xor_si128(_mm_cmpeq_epi32(v, na), ones);
+        }
+        __m128i vz = _mm_and_si128(valid, v);
+        if (What & agg_sum) {
+          __m128i sign = _mm_srai_epi32(vz, 31);
+          sum = _mm_add_epi64(sum, _mm_add_epi64(_mm_unpacklo_epi32(vz, sign),
+                                                 _mm_unpackhi_epi32(vz, sign)));
+        }
+        if (What & agg_count) cnt = _mm_sub_epi32(cnt, valid);
+        if (What & agg_min) {
+          __m128i vm = _mm_or_si128(vz, _mm_andnot_si128(valid, maxv));
+          __m128i lt = _mm_cmplt_epi32(vm, mn);
+          mn = _mm_or_si128(_mm_and_si128(lt, vm), _mm_andnot_si128(lt, mn));
+        }
+        if (What & agg_max) {
+          __m128i vm = _mm_or_si128(vz, _mm_andnot_si128(valid, na));
+          __m128i gt = _mm_cmpgt_epi32(vm, mx);
+          mx = _mm_or_si128(_mm_and_si128(gt, vm), _mm_andnot_si128(gt, mx));
+        }
+        if (What & agg_sumsq) {
+          __m128d lo = _mm_cvtepi32_pd(vz);
+          __m128d hi = _mm_cvtepi32_pd(
+              _mm_shuffle_epi32(vz, _MM_SHUFFLE(3, 2, 3, 2)));
+          sq0 = _mm_add_pd(sq0, _mm_mul_pd(lo, lo));
+          sq1 = _mm_add_pd(sq1, _mm_mul_pd(hi, hi));
+        }
+      }
+    }
+    alignas(16) int64_t s[2];
+    alignas(16) uint32_t c[4];
+    alignas(16) T m[4], M[4];
+    alignas(16) double q[2];
+    _mm_store_si128(reinterpret_cast<__m128i*>(s), sum);
+    _mm_store_si128(reinterpret_cast<__m128i*>(c), cnt);
+    _mm_store_si128(reinterpret_cast<__m128i*>(m), mn);
+    _mm_store_si128(reinterpret_cast<__m128i*>(M), mx);
+    _mm_store_pd(q, _mm_add_pd(sq0, sq1));
+    agg.sum += s[0] + s[1];
+    agg.count += int64_t(c[0]) + c[1] + c[2] + c[3];
+    agg.min = std::min(std::min(m[0], m[1]), std::min(m[2], m[3]));
+    agg.max = std::max(std::max(M[0], M[1]), std::max(M[2], M[3]));
+    agg.sumsq += q[0] + q[1];
+  #endif
+  aggregate_scalar<Bitmask, What>(x + i, valid_bitmap + i/8, n - i, agg);
+}
+
+
+// Name of the aggregate task for the given encoding and set of aggregates.
+static std::string aggregate_name(bool bitmask, unsigned what) {
+  std::string name = bitmask? "agg_bitmask_" : "agg_sentinel_";
+  switch (what) {
+    case agg_sum: return name + "sum";
+    case agg_count: return name + "count";
+    case agg_min: return name + "min";
+    case agg_max: return name + "max";
+    case agg_sumsq: return name + "sumsq";
+    default: return name + "fused";
+  }
+}
+
+
+template <bool Bitmask, unsigned What, bool Simd>
+struct aggregate_task : public task {
+  aggregates result;
+
+  aggregate_task()
+    : task(aggregate_name(Bitmask, What) + (Simd? "_simd" : "")) {}
+
+  double bytes_per_element() const override {
+    return Bitmask? bitmask_bytes_per_element : sizeof(T);
+  }
+
+  void run_once(const input_data& data) override {
+    aggregates agg;
+    kernel(data.data.data(), data.namask.data(), data.n, agg);
+    result = agg;
+    total += agg.sum;
+  }
+
+  static void kernel(const T* x, const uint8_t* valid_bitmap, size_t n,
+                     aggregates& agg) {
+    if (Simd) aggregate_simd<Bitmask, What>(x, valid_bitmap, n, agg);
+    else aggregate_scalar<Bitmask, What>(x, valid_bitmap, n, agg);
+  }
+};
+
+
+// Parallel counterpart of the SIMD aggregate task. The executors only reduce
+// a single `int64_t`, so each chunk stores its aggregates into its own slot
+// (chunk `c` covers `[c * grain, (c + 1) * grain)`), and the slots are merged
+// after the job.
+template <bool Bitmask, unsigned What>
+struct parallel_aggregate : public chunked_task {
+  // Per-chunk aggregates, each on its own cache line. The slots are kept in
+  // a 64-byte aligned `buffer`, since `std::vector` does not honour the
+  // alignment of over-aligned types before C++17.
+  struct alignas(64) padded_aggregates {
+    aggregates agg;
+  };
+
+  aggregates result;
+  buffer<padded_aggregates> partials;
+
+  parallel_aggregate(executor& ex, int nth, size_t gr)
+    : chunked_task(aggregate_task<Bitmask, What, true>().task_name, ex, nth, gr) {}
+
+  double bytes_per_element() const override {
+    return Bitmask? bitmask_bytes_per_element : sizeof(T);
+  }
+
+  void prepare(const input_data& data) override {
+    size_t nchunks = (data.n + grain - 1) / grain;
+    if (partials.size() < nchunks) {
+      alloc_policy aligned;
+      aligned.mode = "aligned";
+      partials.allocate(nchunks, aligned);
+    }
+  }
+
+  void run_once(const input_data& data) override {
+    const T* x = data.data.data();
+    const uint8_t* valid_bitmap = data.namask.data();
+    padded_aggregates* slots = partials.data();
+    const size_t gr = grain;
+    exec.parallel_reduce(nthreads, data.n, grain,
+      [=](size_t i0, size_t i1) {
+        aggregates agg;
+        aggregate_simd<Bitmask, What>(x + i0, valid_bitmap + i0/8, i1 - i0, agg);
+        slots[i0 / gr].agg = agg;
+        return int64_t(0);
+      });
+    aggregates agg;
+    const size_t nchunks = (data.n + gr - 1) / gr;
+    for (size_t c = 0; c < nchunks; ++c) agg.merge(partials[c].agg);
+    result = agg;
+    total += agg.sum;
+  }
+};
+
+
+
+//------------------------------------------------------------------------------
+// Pipelines
+//------------------------------------------------------------------------------
+
+// A small push-based pipeline engine, for queries such as
+//     SELECT sum(y) WHERE x >= threshold
+// over two columns of the same length. The source cuts the rows into morsels
+// and pushes each of them through a chain of stages: the filter stage
+// evaluates the predicate on `x` and produces a selection vector (positions
+// of the qualifying rows within the morsel), which the aggregate stage uses
+// to sum the valid values of `y`. Rows where `x` is NA do not qualify.
+//
+// With cache-sized morsels the selection vector and the morsel of both
+// columns stay in cache between the stages; a single morsel spanning the
+// whole column is the fully materialized plan, where the complete selection
+// vector is written to memory and read back.
+
+// One column of the pipeline's input, with NAs in either encoding.
+template <bool Bitmask>
+struct column_ref {
+  const T* values;
+  const uint8_t* valid_bitmap;
+
+  bool valid(size_t i) const {
+    constexpr T NA = std::numeric_limits<T>::min();
+    return Bitmask? (valid_bitmap[i/8] >> (i & 7)) & 1 : values[i] != NA;
+  }
+};
+
+
+struct pipeline_stage {
+  virtual ~pipeline_stage() {}
+
+  // Processes the morsel of rows `[base, base + len)`, of which only the rows
+  // `base + sel[k]` for `k < nsel` are selected; `sel` is null if all rows
+  // of the morsel are.
+  virtual void push(size_t base, size_t len, const uint32_t* sel,
+                    size_t nsel) = 0;
+};
+
+
+template <bool Bitmask>
+struct filter_stage : public pipeline_stage {
+  column_ref<Bitmask> x;
+  T threshold;
+  uint32_t* sel_out;  // room for one morsel
+  pipeline_stage* next;
+
+  filter_stage(column_ref<Bitmask> col, T thr, uint32_t* out,
+               pipeline_stage* nxt)
+    : x(col), threshold(thr), sel_out(out), next(nxt) {}
+
+  void push(size_t base, size_t len, const uint32_t* sel,
+            size_t nsel) override {
+    size_t k = 0;
+    if (sel) {
+      for (size_t j = 0; j < nsel; ++j) {
+        size_t i = base + sel[j];
+        sel_out[k] = sel[j];
+        k += x.valid(i) & (x.values[i] >= threshold);
+      }
+    } else {
+      // branch-free: always write the position, advance if it qualifies
+      for (size_t j = 0; j < len; ++j) {
+        size_t i = base + j;
+        sel_out[k] = static_cast<uint32_t>(j);
+        k += x.valid(i) & (x.values[i] >= threshold);
+      }
+    }
+    next->push(base, len, sel_out, k);
+  }
+};
+
+
+template <bool Bitmask>
+struct sum_stage : public pipeline_stage {
+  column_ref<Bitmask> y;
+  int64_t sum;
+
+  explicit sum_stage(column_ref<Bitmask> col) : y(col), sum(0) {}
+
+  void push(size_t base, size_t len, const uint32_t* sel,
+            size_t nsel) override {
+    int64_t s = 0;
+    if (sel) {
+      for (size_t k = 0; k < nsel; ++k) {
+        size_t i = base + sel[k];
+        s += y.values[i] * static_cast<T>(y.valid(i));
+      }
+    } else {
+      for (size_t i = base; i < base + len; ++i) {
+        s += y.values[i] * static_cast<T>(y.valid(i));
+      }
+    }
+    sum += s;
+  }
+};
+
+
+// Pushes the rows `[begin, end)` through `first` in morsels of `morsel` rows.
+static void run_pipeline(pipeline_stage& first, size_t begin, size_t end,
+                         size_t morsel) {
+  for (size_t base = begin; base < end; base += morsel) {
+    first.push(base, std::min(morsel, end - base), nullptr, 0);
+  }
+}
+
+
+// Filter-and-sum query over the column of the task's input (as `x`) and the
+// column `y`, in morsels of the given size (0 for a single morsel, i.e. full
+// materialization of the selection vector).
+template <bool Bitmask>
+struct pipeline_task : public task {
+  const input_data& y;
+  size_t morsel;
+  T threshold;
+  std::vector<uint32_t> sel;
+
+  pipeline_task(const input_data& ycol, size_t morsel_size, T thr)
+    : task(std::string(Bitmask? "pipeline_bitmask" : "pipeline_sentinel") +
+           "_" + (morsel_size? std::to_string(morsel_size) : "full")),
+      y(ycol), morsel(morsel_size), threshold(thr) {}
+
+  double bytes_per_element() const override {
+    return 2 * (Bitmask? bitmask_bytes_per_element : sizeof(T));
+  }
+
+  void prepare(const input_data& data) override {
+    sel.resize(std::max<size_t>(1, morsel? morsel : data.n));
+  }
+
+  void run_once(const input_data& data) override {
+    column_ref<Bitmask> xcol = {data.data.data(), data.namask.data()};
+    column_ref<Bitmask> ycol = {y.data.data(), y.namask.data()};
+    sum_stage<Bitmask> agg(ycol);
+    filter_stage<Bitmask> filter(xcol, threshold, sel.data(), &agg);
+    run_pipeline(filter, 0, data.n, morsel? morsel : data.n);
+    total += agg.sum;
+  }
+};
+
+
+// Morsel-driven parallel execution of the same query: the executor hands out
+// morsels (its chunks) to the threads, and each thread pushes them through
+// its own instance of the pipeline, with a thread-local selection vector.
+template <bool Bitmask>
+struct parallel_pipeline_task : public chunked_task {
+  const input_data& y;
+  T threshold;
+
+  parallel_pipeline_task(executor& ex, int nth, const input_data& ycol,
+                         size_t morsel_size, T thr)
+    : chunked_task(pipeline_task<Bitmask>(ycol, morsel_size, thr).task_name,
+                   ex, nth, morsel_size),
+      y(ycol), threshold(thr) {}
+
+  double bytes_per_element() const override {
+    return 2 * (Bitmask? bitmask_bytes_per_element : sizeof(T));
+  }
+
+  void run_once(const input_data& data) override {
+    column_ref<Bitmask> xcol = {data.data.data(), data.namask.data()};
+    column_ref<Bitmask> ycol = {y.data.data(), y.namask.data()};
+    const T thr = threshold;
+    const size_t morsel = grain;
+    total += exec.parallel_reduce(nthreads, data.n, grain,
+      [=](size_t i0, size_t i1) {
+        thread_local std::vector<uint32_t> sel;
+        if (sel.size() < morsel) sel.resize(morsel);
+        sum_stage<Bitmask> agg(ycol);
+        filter_stage<Bitmask> filter(xcol, thr, sel.data(), &agg);
+        run_pipeline(filter, i0, i1, morsel);
+        return agg.sum;
+      });
+  }
+};
+
+
+
+//------------------------------------------------------------------------------
+// Filtered aggregation
+//------------------------------------------------------------------------------
+
+// Strategies for `SELECT sum(x) WHERE f < threshold`, where `f` is a filter
+// column without NAs, and the rows where `x` is NA are skipped. They differ in
+// how the rows surviving the filter are represented:
+//   selection - the positions of the rows passing the filter are collected
+//               into a selection vector (a block at a time), and the values
+//               are then gathered by index, checking the NA encoding;
+//   bitmap    - the filter produces a bitmap (64 rows per word), which is
+//               AND-ed with the validity bitmap, and the values are summed
+//               under the combined mask, skipping words with no bit set;
+//   compare   - a single branch-free pass with the sentinel compare and the
+//               filter compare combined, as a vectorizing compiler emits.
+
+// Rows per block of the selection vector (a multiple of 8, and at most 2^16,
+// since the positions in the block are stored as `uint16_t`).
+constexpr size_t filter_block = 1024;
+
+
+struct filtered_sum_task : public task {
+  const std::vector<T>& filter;
+  T threshold;
+
+  filtered_sum_task(const std::string& name, const std::vector<T>& f, T thr)
+    : task(name), filter(f), threshold(thr) {}
+};
+
+
+template <bool Bitmask>
+struct filtered_sum_selection : public filtered_sum_task {
+  filtered_sum_selection(const std::vector<T>& f, T thr)
+    : filtered_sum_task(Bitmask? "filtered_bitmask_selection"
+                               : "filtered_sentinel_selection", f, thr) {}
+
+  double bytes_per_element() const override {
+    return sizeof(T) + (Bitmask? bitmask_bytes_per_element : sizeof(T));
+  }
+
+  void run_once(const input_data& data) override {
+    constexpr T NA = std::numeric_limits<T>::min();
+    const T* x = data.data.data();
+    const uint8_t* valid_bitmap = data.namask.data();
+    const T* f = filter.data();
+    const T thr = threshold;
+    // positions relative to the block, so that any `n` fits
+    uint16_t sel[filter_block];
+    int64_t s = 0;
+    for (size_t i0 = 0; i0 < data.n; i0 += filter_block) {
+      size_t len = std::min(filter_block, data.n - i0);
+      size_t k = 0;
+      for (size_t j = 0; j < len; ++j) {
+        sel[k] = static_cast<uint16_t>(j);
+        k += f[i0 + j] < thr;
+      }
+      const T* xb = x + i0;
+      const uint8_t* vb = valid_bitmap + i0/8;
+      for (size_t j = 0; j < k; ++j) {
+        size_t i = sel[j];
+        if (Bitmask) {
+          s += xb[i] * static_cast<T>((vb[i/8] >> (i & 7)) & 1);
+        } else {
+          s += xb[i] != NA? xb[i] : 0;
+        }
+      }
+    }
+    total += s;
+  }
+};
+
+
+struct filtered_sum_bitmap : public filtered_sum_task {
+  filtered_sum_bitmap(const std::vector<T>& f, T thr)
+    : filtered_sum_task("filtered_bitmask_bitmap", f, thr) {}
+
+  double bytes_per_element() const override {
+    return sizeof(T) + bitmask_bytes_per_element;
+  }
+
+  // With SSE2 the filter bitmap is built 16 rows at a time (compare, pack to
+  // bytes, `movemask`), and the masked sum expands each byte of the combined
+  // mask into lane masks as in `bitmask_to_sentinel_simd`.
+  void run_once(const input_data& data) override {
+    const T* x = data.data.data();
+    const uint8_t* valid_bitmap = data.namask.data();
+    const T* f = filter.data();
+    const T thr = threshold;
+    const size_t n = data.n;
+    int64_t s = 0;
+    size_t i0 = 0;
+    #ifdef __SSE2__
+      const __m128i vthr = _mm_set1_epi32(thr);
+      const __m128i bits_lo = _mm_setr_epi32(1, 2, 4, 8);
+      const __m128i bits_hi = _mm_setr_epi32(16, 32, 64, 128);
+      __m128i sum = _mm_setzero_si128();
+      for (; i0 + 64 <= n; i0 += 64) {
+        uint64_t pass = 0;
+        for (int q = 0; q < 4; ++q) {
+          const __m128i* v = reinterpret_cast<const __m128i*>(f + i0 + 16 * q);
+          __m128i c0 = _mm_cmplt_epi32(_mm_loadu_si128(v), vthr);
+          __m128i c1 = _mm_cmplt_epi32(_mm_loadu_si128(v + 1), vthr);
+          __m128i c2 = _mm_cmplt_epi32(_mm_loadu_si128(v + 2), vthr);
+          __m128i c3 = _mm_cmplt_epi32(_mm_loadu_si128(v + 3), vthr);
+          __m128i c = _mm_packs_epi16(_mm_packs_epi32(c0, c1),
+                                      _mm_packs_epi32(c2, c3));
+          pass |= static_cast<uint64_t>(
+                      static_cast<uint16_t>(_mm_movemask_epi8(c))) << (16 * q);
+        }
+        uint64_t valid;
+        memcpy(&valid, valid_bitmap + i0/8, sizeof(valid));
+        uint64_t mask = pass & valid;
+        if (!mask) continue;
+        for (int b = 0; b < 8; ++b) {
+          __m128i byte = _mm_set1_epi32(static_cast<int>((mask >> (8 * b)) & 0xFF));
+          __m128i m_lo = _mm_cmpeq_epi32(_mm_and_si128(byte, bits_lo), bits_lo);
+          __m128i m_hi = _mm_cmpeq_epi32(_mm_and_si128(byte, bits_hi), bits_hi);
+          const __m128i* v = reinterpret_cast<const __m128i*>(x + i0 + 8 * b);
+          __m128i x_lo = _mm_and_si128(m_lo, _mm_loadu_si128(v));
+          __m128i x_hi = _mm_and_si128(m_hi, _mm_loadu_si128(v + 1));
+          __m128i sign_lo = _mm_srai_epi32(x_lo, 31);
+          __m128i sign_hi = _mm_srai_epi32(x_hi, 31);
+          sum = _mm_add_epi64(sum, _mm_add_epi64(_mm_unpacklo_epi32(x_lo, sign_lo),
+                                                 _mm_unpackhi_epi32(x_lo, sign_lo)));
+          sum = _mm_add_epi64(sum, _mm_add_epi64(_mm_unpacklo_epi32(x_hi, sign_hi),
+                                                 _mm_unpackhi_epi32(x_hi, sign_hi)));
+        }
+      }
+      alignas(16) int64_t lanes[2];
+      _mm_store_si128(reinterpret_cast<__m128i*>(lanes), sum);
+      s += lanes[0] + lanes[1];
+    #endif
+    for (; i0 < n; i0 += 64) {
+      size_t len = std::min(size_t(64), n - i0);
+      uint64_t pass = 0;
+      for (size_t j = 0; j < len; ++j) {
+        pass |= static_cast<uint64_t>(f[i0 + j] < thr) << j;
+      }
+      uint64_t valid = 0;
+      memcpy(&valid, valid_bitmap + i0/8, (len + 7) / 8);
+      uint64_t mask = pass & valid;
+      if (!mask) continue;
+      for (size_t j = 0; j < len; ++j) {
+        s += x[i0 + j] * static_cast<T>((mask >> j) & 1);
+      }
+    }
+    total += s;
+  }
+};
+
+
+struct filtered_sum_compare : public filtered_sum_task {
+  filtered_sum_compare(const std::vector<T>& f, T thr)
+    : filtered_sum_task("filtered_sentinel_compare", f, thr) {}
+
+  double bytes_per_element() const override { return 2 * sizeof(T); }
+
+  void run_once(const input_data& data) override {
+    constexpr T NA = std::numeric_limits<T>::min();
+    const T* x = data.data.data();
+    const T* f = filter.data();
+    const T thr = threshold;
+    int64_t s = 0;
+    for (size_t i = 0; i < data.n; ++i) {
+      T keep = -static_cast<T>((f[i] < thr) & (x[i] != NA));
+      s += x[i] & keep;
+    }
+    total += s;
+  }
+};
+
+
+
+//------------------------------------------------------------------------------
+// Conversion tasks
+//------------------------------------------------------------------------------
+
+// These tasks convert one NA representation into the other, as done at the
+// boundary between a bitmask-based format (e.g. Arrow) and sentinel-based
+// processing. Their throughput counts both the bytes read and the bytes
+// written per element, and their `total` is left unchanged. Like the kernels
+// of the summing methods, the conversion kernels work on ranges that start on
+// a multiple of 8 elements, so that the parallel variants can reuse them.
+
+// Outputs of the conversions: each owns its buffer, allocates it in
+// `prepare()` and gives the bytes per element read and written. They are held
+// by both the serial conversion tasks and their parallel counterparts.
+
+// A new vector of values, for the conversions into sentinels.
+struct sentinel_output {
+  static constexpr double bytes_per_element = 2 * sizeof(T) + 1.0 / 8;
+  buffer<T> out;
+
+  void prepare(const input_data& data) {
+    if (out.size() != data.n) out.allocate(data.n, data.alloc);
+  }
+
+  // Position in `out` corresponding to element `i`.
+  static size_t index(size_t i) { return i; }
+};
+
+
+// A new validity bitmap, for the conversions into bitmasks.
+struct bitmask_output {
+  static constexpr double bytes_per_element = sizeof(T) + 1.0 / 8;
+  buffer<uint8_t> out;
+
+  void prepare(const input_data& data) {
+    if (out.size() != (data.n + 7) / 8) out.allocate((data.n + 7) / 8, data.alloc);
+  }
+
+  static size_t index(size_t i) { return i / 8; }
+};
+
+
+// Base of the serial conversion tasks writing into an `Output`.
+template <typename Output>
+struct conversion_task : public task {
+  typedef Output output_type;
+  Output output;
+
+  conversion_task(const std::string& name) : task(name) {}
+
+  double bytes_per_element() const override {
+    return Output::bytes_per_element;
+  }
+
+  void prepare(const input_data& data) override { output.prepare(data); }
+};
+
+typedef conversion_task<sentinel_output> to_sentinel_task;
+typedef conversion_task<bitmask_output> to_bitmask_task;
+
+
+struct bitmask_to_sentinel : public to_sentinel_task {
+  bitmask_to_sentinel() : to_sentinel_task("bitmask_to_sentinel") {}
+
+  void run_once(const input_data& data) override {
+    kernel(data.data.data(), data.namask.data(), data.n,
+           output.out.data());
+  }
+
+  static void kernel(const T* x, const uint8_t* valid_bitmap, size_t n,
+                     T* out) {
+    constexpr T NA = std::numeric_limits<T>::min();
+    for (size_t i = 0; i < n; ++i) {
+      out[i] = ((valid_bitmap[i/8] >> (i & 7)) & 1)? x[i] : NA;
+    }
+  }
+};
+
+
+// Expands each bitmap byte into two 4-lane masks (by testing one bit per
+// lane), and blends the values with the sentinel under these masks.
+struct bitmask_to_sentinel_simd : public to_sentinel_task {
+  bitmask_to_sentinel_simd() : to_sentinel_task("bitmask_to_sentinel_simd") {}
+
+  void run_once(const input_data& data) override {
+    kernel(data.data.data(), data.namask.data(), data.n,
+           output.out.data());
+  }
+
+  static void kernel(const T* x, const uint8_t* valid_bitmap, size_t n,
+                     T* out) {
+    constexpr T NA = std::numeric_limits<T>::min();
+    size_t i = 0;
+    #ifdef __SSE2__
+      const __m128i na = _mm_set1_epi32(NA);
+      const __m128i bits_lo = _mm_setr_epi32(1, 2, 4, 8);
+      const __m128i bits_hi = _mm_setr_epi32(16, 32, 64, 128);
+      for (; i + 8 <= n; i += 8) {
+        __m128i byte = _mm_set1_epi32(valid_bitmap[i/8]);
+        __m128i valid_lo = _mm_cmpeq_epi32(_mm_and_si128(byte, bits_lo), bits_lo);
+        __m128i valid_hi = _mm_cmpeq_epi32(_mm_and_si128(byte, bits_hi), bits_hi);
+        __m128i x_lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i));
+        __m128i x_hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i + 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                         _mm_or_si128(_mm_and_si128(valid_lo, x_lo),
+                                      _mm_andnot_si128(valid_lo, na)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 4),
+                         _mm_or_si128(_mm_and_si128(valid_hi, x_hi),
+                                      _mm_andnot_si128(valid_hi, na)));
+      }
+    #endif
+    for (; i < n; ++i) {
+      out[i] = ((valid_bitmap[i/8] >> (i & 7)) & 1)? x[i] : NA;
+    }
+  }
+};
+
+
+struct sentinel_to_bitmask : public to_bitmask_task {
+  sentinel_to_bitmask() : to_bitmask_task("sentinel_to_bitmask") {}
+
+  void run_once(const input_data& data) override {
+    kernel(data.data.data(), data.namask.data(), data.n,
+           output.out.data());
+  }
+
+  static void kernel(const T* x, const uint8_t*, size_t n, uint8_t* out) {
+    constexpr T NA = std::numeric_limits<T>::min();
+    const size_t nbatches = n / 8;
+    for (size_t i = 0; i < nbatches; ++i) {
+      out[i] = static_cast<uint8_t>((x[0] != NA) |
+                                    ((x[1] != NA) << 1) |
+                                    ((x[2] != NA) << 2) |
+                                    ((x[3] != NA) << 3) |
+                                    ((x[4] != NA) << 4) |
+                                    ((x[5] != NA) << 5) |
+                                    ((x[6] != NA) << 6) |
+                                    ((x[7] != NA) << 7));
+      x += 8;
+    }
+    if (n & 7) {
+      uint8_t valid_byte = 0;
+      for (size_t j = 0; j < (n & 7); ++j) {
+        valid_byte |= static_cast<uint8_t>((x[j] != NA) << j);
+      }
+      out[nbatches] = valid_byte;
+    }
+  }
+};
+
+
+// Compares 16 values at a time with the sentinel, narrows the comparison
+// results to bytes with saturating packs, and collects their sign bits with
+// `movemask` into two bytes of the (inverted) bitmap.
+struct sentinel_to_bitmask_simd : public to_bitmask_task {
+  sentinel_to_bitmask_simd() : to_bitmask_task("sentinel_to_bitmask_simd") {}
+
+  void run_once(const input_data& data) override {
+    kernel(data.data.data(), data.namask.data(), data.n,
+           output.out.data());
+  }
+
+  static void kernel(const T* x, const uint8_t*, size_t n, uint8_t* out) {
+    size_t i = 0;
+    #ifdef __SSE2__
+      const __m128i na = _mm_set1_epi32(std::numeric_limits<T>::min());
+      for (; i + 16 <= n; i += 16) {
+        const __m128i* v = reinterpret_cast<const __m128i*>(x + i);
+        __m128i na0 = _mm_cmpeq_epi32(_mm_loadu_si128(v), na);
+        __m128i na1 = _mm_cmpeq_epi32(_mm_loadu_si128(v + 1), na);
+        __m128i na2 = _mm_cmpeq_epi32(_mm_loadu_si128(v + 2), na);
+        __m128i na3 = _mm_cmpeq_epi32(_mm_loadu_si128(v + 3), na);
+        __m128i na_bytes = _mm_packs_epi16(_mm_packs_epi32(na0, na1),
+                                           _mm_packs_epi32(na2, na3));
+        uint16_t valid_bits =
+            static_cast<uint16_t>(~_mm_movemask_epi8(na_bytes));
+        memcpy(out + i/8, &valid_bits, sizeof(valid_bits));
+      }
+    #endif
+    sentinel_to_bitmask::kernel(x + i, nullptr, n - i, out + i/8);
+  }
+};
+
+
+// Parallel counterpart of the conversion `K`, in the same way as
+// `parallel_of`: since the chunks are multiples of 64 elements, no two chunks
+// write into the same byte of an output bitmap.
+template <typename K>
+struct parallel_conversion : public chunked_task {
+  typedef typename K::output_type output_type;
+  output_type output;
+
+  parallel_conversion(executor& ex, int nth, size_t gr)
+    : chunked_task(K().task_name, ex, nth, gr) {}
+
+  double bytes_per_element() const override {
+    return output_type::bytes_per_element;
+  }
+
+  void prepare(const input_data& data) override { output.prepare(data); }
+
+  void run_once(const input_data& data) override {
+    const T* x = data.data.data();
+    const uint8_t* valid_bitmap = data.namask.data();
+    auto out = output.out.data();
+    exec.parallel_reduce(nthreads, data.n, grain,
+      [=](size_t i0, size_t i1) {
+        K::kernel(x + i0, valid_bitmap + i0/8, i1 - i0,
+                  out + output_type::index(i0));
+        return int64_t(0);
+      });
+  }
+};
+
+
+// Runs the parallel conversions once on every executor, and compares their
+// outputs with those of the serial conversions; returns the number of
+// conversions whose outputs differ.
+template <typename K>
+static int check_parallel_conversion(const input_data& data,
+                                     const std::vector<executor*>& executors,
+                                     int t, size_t grain) {
+  K serial;
+  serial.prepare(data);
+  serial.run_once(data);
+  int mismatches = 0;
+  for (executor* ex : executors) {
+    parallel_conversion<K> par(*ex, t, grain);
+    par.prepare(data);
+    par.run_once(data);
+    // an empty output has nothing to compare (and may have null data)
+    if (serial.output.out.size() &&
+        memcmp(par.output.out.data(), serial.output.out.data(),
+               serial.output.out.size() * sizeof(*serial.output.out.data()))) {
+      printf("  %s differs from %s\n", par.task_name.c_str(),
+             serial.task_name.c_str());
+      mismatches++;
+    }
+  }
+  return mismatches;
+}
+
+
+
+//------------------------------------------------------------------------------
+// Reduction strategies
+//------------------------------------------------------------------------------
+
+// These tasks all compute `sum_sentinel_nulls_mul` with each OMP thread
+// processing one contiguous slice of the vector; they differ only in how the
+// per-thread partial sums are combined. At small `n` the combining step is a
+// significant part of the total time, which is what `--reductions` measures.
+
+// 64-bit accumulator that occupies a whole cache line.
+struct alignas(64) padded_int64 {
+  int64_t value;
+};
+
+// Makes `slots` hold at least `n` accumulators. They live in a 64-byte
+// aligned `buffer`, since `std::vector` does not honour the alignment of
+// over-aligned types before C++17.
+static void reserve_slots(buffer<padded_int64>& slots, int n) {
+  if (slots.size() < static_cast<size_t>(n)) {
+    alloc_policy aligned;
+    aligned.mode = "aligned";
+    slots.allocate(static_cast<size_t>(n), aligned);
+  }
+}
+
+
+// Per-thread partial sums combined with `#pragma omp atomic`.
+struct reduce_atomic : public parallel_task {
+  reduce_atomic(int nth) : parallel_task("reduce_atomic", nth) {}
+
+  void run_once(const input_data& data) override {
+    const size_t n = data.n;
+    const T* x = data.data.data();
+    #pragma omp parallel num_threads(nthreads)
+    {
+      size_t nth = static_cast<size_t>(omp_get_num_threads());
+      size_t ith = static_cast<size_t>(omp_get_thread_num());
+      int64_t subtotal = 0;
+      sum_sentinel_nulls_mul::kernel(x + n * ith / nth, nullptr,
+                                     n * (ith + 1) / nth - n * ith / nth,
+                                     subtotal);
+      #pragma omp atomic update
+      total += subtotal;
+    }
+  }
+};
+
+
+// Partial sums combined by the OMP runtime's `reduction` clause.
+struct reduce_omp : public parallel_task {
+  reduce_omp(int nth) : parallel_task("reduce_omp", nth) {}
+
+  void run_once(const input_data& data) override {
+    const size_t n = data.n;
+    const T* x = data.data.data();
+    int64_t sum = 0;
+    #pragma omp parallel num_threads(nthreads) reduction(+:sum)
+    {
+      size_t nth = static_cast<size_t>(omp_get_num_threads());
+      size_t ith = static_cast<size_t>(omp_get_thread_num());
+      sum_sentinel_nulls_mul::kernel(x + n * ith / nth, nullptr,
+                                     n * (ith + 1) / nth - n * ith / nth,
+                                     sum);
+    }
+    total += sum;
+  }
+};
+
+
+// Baseline for the strategies above: the same parallel region and kernel,
+// with each subtotal stored into a padded per-thread slot and never combined
+// (so `total` is left unchanged). The cost of a reduction strategy is its
+// time minus the time of this task.
+struct reduce_none : public parallel_task {
+  buffer<padded_int64> slots;
+
+  reduce_none(int nth) : parallel_task("reduce_none", nth) {}
+
+  void run_once(const input_data& data) override {
+    const size_t n = data.n;
+    const T* x = data.data.data();
+    reserve_slots(slots, nthreads);
+    #pragma omp parallel num_threads(nthreads)
+    {
+      size_t nth = static_cast<size_t>(omp_get_num_threads());
+      size_t ith = static_cast<size_t>(omp_get_thread_num());
+      int64_t subtotal = 0;
+      sum_sentinel_nulls_mul::kernel(x + n * ith / nth, nullptr,
+                                     n * (ith + 1) / nth - n * ith / nth,
+                                     subtotal);
+      slots[ith].value = subtotal;
+    }
+  }
+};
+
+
+// Each thread keeps its running sum in its own slot of a shared array,
+// storing it (through a volatile pointer, so that the stores are not
+// optimized away) after every block of `block` elements, and the master
+// thread adds the slots up. With `padded = false` the slots are adjacent
+// 8-byte integers, so up to 8 threads keep writing into the same cache line
+// (false sharing); with `padded = true` each slot has its own cache line.
+template <bool padded>
+struct reduce_slots : public parallel_task {
+  static constexpr size_t block = 64;
+
+  std::vector<int64_t> slots;
+  buffer<padded_int64> padded_slots;
+
+  reduce_slots(int nth)
+    : parallel_task(padded? "reduce_padded_slots" : "reduce_shared_slots",
+                    nth) {}
+
+  void run_once(const input_data& data) override {
+    const size_t n = data.n;
     const T* x = data.data.data();
-    #pragma omp parallel for reduction (+:total) num_threads(nthreads)
-    for (size_t i = 0; i < n; ++i) {
-      total += x[i] * (x[i] != NA);
+    slots.resize(nthreads);
+    reserve_slots(padded_slots, nthreads);
+    int nused = 0;
+    #pragma omp parallel num_threads(nthreads)
+    {
+      size_t nth = static_cast<size_t>(omp_get_num_threads());
+      size_t ith = static_cast<size_t>(omp_get_thread_num());
+      volatile int64_t* slot = padded? &padded_slots[ith].value : &slots[ith];
+      *slot = 0;
+      const size_t i1 = n * (ith + 1) / nth;
+      for (size_t i = n * ith / nth; i < i1; i += block) {
+        int64_t running = *slot;
+        sum_sentinel_nulls_mul::kernel(x + i, nullptr,
+                                       std::min(block, i1 - i), running);
+        *slot = running;
+      }
+      #pragma omp master
+      nused = static_cast<int>(nth);
+    }
+    for (int i = 0; i < nused; ++i) {
+      total += padded? padded_slots[i].value : slots[i];
     }
   }
 };
+template <bool padded>
+constexpr size_t reduce_slots<padded>::block;
 
 
-struct sum_bitmask_nulls_omp2 : public task {
-  int nthreads;
-  sum_bitmask_nulls_omp2(int nth) : task("sum_bitmask_nulls_omp2") {
-    nthreads = nth;
-  }
+// Padded per-thread slots combined pairwise in log2(nthreads) steps, with a
+// barrier between the steps.
+struct reduce_tree : public parallel_task {
+  buffer<padded_int64> slots;
+
+  reduce_tree(int nth) : parallel_task("reduce_tree", nth) {}
 
   void run_once(const input_data& data) override {
     const size_t n = data.n;
-    const size_t nbatches = n / 8;
     const T* x = data.data.data();
-    const uint8_t* valid_bitmap = data.namask.data();
-    #pragma omp parallel for reduction (+:total) num_threads(nthreads)
-    for (size_t i = 0; i < nbatches; ++i) {
-      uint8_t valid_byte = valid_bitmap[i];
-      const T* xx = x + (i << 3);
-      total += xx[0] * (valid_byte & 1) +
-               xx[1] * ((valid_byte >> 1) & 1) +
-               xx[2] * ((valid_byte >> 2) & 1) +
-               xx[3] * ((valid_byte >> 3) & 1) +
-               xx[4] * ((valid_byte >> 4) & 1) +
-               xx[5] * ((valid_byte >> 5) & 1) +
-               xx[6] * ((valid_byte >> 6) & 1) +
-               xx[7] * ((valid_byte >> 7) & 1);
-    }
-    for (size_t i = nbatches * 8; i < n; ++i) {
-      total += x[i] * ((valid_bitmap[i/8] >> (i & 7)) & 1);
+    reserve_slots(slots, nthreads);
+    #pragma omp parallel num_threads(nthreads)
+    {
+      size_t nth = static_cast<size_t>(omp_get_num_threads());
+      size_t ith = static_cast<size_t>(omp_get_thread_num());
+      int64_t subtotal = 0;
+      sum_sentinel_nulls_mul::kernel(x + n * ith / nth, nullptr,
+                                     n * (ith + 1) / nth - n * ith / nth,
+                                     subtotal);
+      slots[ith].value = subtotal;
+      for (size_t stride = 1; stride < nth; stride *= 2) {
+        #pragma omp barrier
+        if (ith % (2 * stride) == 0 && ith + stride < nth) {
+          slots[ith].value += slots[ith + stride].value;
+        }
+      }
     }
+    total += slots[0].value;
+  }
+};
+
+
+// Work-stealing pool with one chunk per thread: the partial sums are combined
+// from the pool's padded worker slots, without any OMP involvement.
+struct reduce_pool : public parallel_task {
+  executor& exec;
+
+  reduce_pool(executor& ex, int nth)
+    : parallel_task("reduce_pool", nth), exec(ex) {}
+
+  void run_once(const input_data& data) override {
+    const T* x = data.data.data();
+    size_t grain = (data.n / nthreads + 63) / 64 * 64;
+    total += exec.parallel_reduce(nthreads, data.n, std::max(grain, size_t(64)),
+      [=](size_t i0, size_t i1) {
+        int64_t subtotal = 0;
+        sum_sentinel_nulls_mul::kernel(x + i0, nullptr, i1 - i0, subtotal);
+        return subtotal;
+      });
   }
 };
 
 
 
+// All benchmarked methods, in the order in which they are reported.
+static std::vector<std::unique_ptr<task>> make_tasks(int t,
+                                                     const run_context& ctx) {
+  executor& pool = *ctx.pool;
+  executor& omp = *ctx.omp;
+  const size_t g = ctx.grain;
+  std::vector<std::unique_ptr<task>> tasks;
+  tasks.emplace_back(new sum_ignore_nulls);
+  tasks.emplace_back(new sum_ignore_nulls_batched);
+  tasks.emplace_back(new sum_sentinel_nulls_if);
+  tasks.emplace_back(new sum_sentinel_nulls_mul);
+  tasks.emplace_back(new sum_sentinel_nulls_batched);
+  tasks.emplace_back(new sum_bitmask_nulls);
+  tasks.emplace_back(new sum_bitmask_nulls_batched);
+  tasks.emplace_back(new sum_bitmask_nulls_shortcut);
+  tasks.emplace_back(new sum_sentinel_nulls_omp1(t));
+  tasks.emplace_back(new sum_sentinel_nulls_omp2(t));
+  tasks.emplace_back(new sum_bitmask_nulls_omp2(t));
+  tasks.emplace_back(new local_of<sum_ignore_nulls>);
+  tasks.emplace_back(new local_of<sum_ignore_nulls_batched>);
+  tasks.emplace_back(new local_of<sum_sentinel_nulls_if>);
+  tasks.emplace_back(new local_of<sum_sentinel_nulls_mul>);
+  tasks.emplace_back(new local_of<sum_sentinel_nulls_batched>);
+  tasks.emplace_back(new local_of<sum_bitmask_nulls>);
+  tasks.emplace_back(new local_of<sum_bitmask_nulls_batched>);
+  tasks.emplace_back(new local_of<sum_bitmask_nulls_shortcut>);
+  std::vector<executor*> executors;
+  if (ctx.executors != "pool") executors.push_back(&omp);
+  if (ctx.executors != "omp") executors.push_back(&pool);
+  for (executor* ex : executors) {
+    tasks.emplace_back(new parallel_of<sum_ignore_nulls>(*ex, t, g));
+    tasks.emplace_back(new parallel_of<sum_ignore_nulls_batched>(*ex, t, g));
+    tasks.emplace_back(new parallel_of<sum_sentinel_nulls_if>(*ex, t, g));
+    tasks.emplace_back(new parallel_of<sum_sentinel_nulls_mul>(*ex, t, g));
+    tasks.emplace_back(new parallel_of<sum_sentinel_nulls_batched>(*ex, t, g));
+    tasks.emplace_back(new parallel_of<sum_bitmask_nulls>(*ex, t, g));
+    tasks.emplace_back(new parallel_of<sum_bitmask_nulls_batched>(*ex, t, g));
+    tasks.emplace_back(new parallel_of<sum_bitmask_nulls_shortcut>(*ex, t, g));
+  }
+  tasks.emplace_back(new with_stats<sum_sentinel_nulls_if>);
+  tasks.emplace_back(new with_stats<sum_sentinel_nulls_mul>);
+  tasks.emplace_back(new with_stats<sum_sentinel_nulls_batched>);
+  tasks.emplace_back(new with_stats<sum_bitmask_nulls>);
+  tasks.emplace_back(new with_stats<sum_bitmask_nulls_batched>);
+  tasks.emplace_back(new with_stats<sum_bitmask_nulls_shortcut>);
+  for (executor* ex : executors) {
+    tasks.emplace_back(new parallel_with_stats<sum_sentinel_nulls_if>(*ex, t, g));
+    tasks.emplace_back(new parallel_with_stats<sum_sentinel_nulls_mul>(*ex, t, g));
+    tasks.emplace_back(new parallel_with_stats<sum_sentinel_nulls_batched>(*ex, t, g));
+    tasks.emplace_back(new parallel_with_stats<sum_bitmask_nulls>(*ex, t, g));
+    tasks.emplace_back(new parallel_with_stats<sum_bitmask_nulls_batched>(*ex, t, g));
+    tasks.emplace_back(new parallel_with_stats<sum_bitmask_nulls_shortcut>(*ex, t, g));
+  }
+  tasks.emplace_back(new sum_bitmask_nulls_zonemap);
+  tasks.emplace_back(new count_bitmask_nulls);
+  tasks.emplace_back(new count_bitmask_nulls_zonemap);
+  tasks.emplace_back(new min_bitmask_nulls);
+  tasks.emplace_back(new min_bitmask_nulls_zonemap);
+  tasks.emplace_back(new sum_sparse_nulls<uint32_t>);
+  tasks.emplace_back(new sum_sparse_nulls<uint64_t>);
+  for (executor* ex : executors) {
+    tasks.emplace_back(new parallel_sum_sparse_nulls<uint32_t>(*ex, t, g));
+  }
+  tasks.emplace_back(new sum_roaring_nulls);
+  tasks.emplace_back(new count_roaring_nulls);
+  tasks.emplace_back(new filter_bitmask_nulls);
+  tasks.emplace_back(new filter_roaring_nulls);
+  tasks.emplace_back(new sum_rle_nulls);
+  tasks.emplace_back(new count_rle_nulls);
+  tasks.emplace_back(new sum_dict_nulls);
+  tasks.emplace_back(new sum_dict_nulls_histogram);
+  tasks.emplace_back(new count_dict_nulls);
+  tasks.emplace_back(new sum_packed_nulls<false>);
+  tasks.emplace_back(new sum_packed_nulls_simd<false>);
+  tasks.emplace_back(new sum_packed_nulls<true>);
+  tasks.emplace_back(new sum_packed_nulls_simd<true>);
+  for (executor* ex : executors) {
+    tasks.emplace_back(new parallel_sum_packed_nulls<false>(*ex, t, g));
+    tasks.emplace_back(new parallel_sum_packed_nulls<true>(*ex, t, g));
+  }
+  tasks.emplace_back(new aggregate_task<false, agg_all, false>);
+  tasks.emplace_back(new aggregate_task<false, agg_all, true>);
+  tasks.emplace_back(new aggregate_task<true, agg_all, false>);
+  tasks.emplace_back(new aggregate_task<true, agg_all, true>);
+  for (executor* ex : executors) {
+    tasks.emplace_back(new parallel_aggregate<false, agg_all>(*ex, t, g));
+    tasks.emplace_back(new parallel_aggregate<true, agg_all>(*ex, t, g));
+  }
+  tasks.emplace_back(new bitmask_to_sentinel);
+  tasks.emplace_back(new bitmask_to_sentinel_simd);
+  tasks.emplace_back(new sentinel_to_bitmask);
+  tasks.emplace_back(new sentinel_to_bitmask_simd);
+  for (executor* ex : executors) {
+    tasks.emplace_back(
+        new parallel_conversion<bitmask_to_sentinel_simd>(*ex, t, g));
+    tasks.emplace_back(
+        new parallel_conversion<sentinel_to_bitmask_simd>(*ex, t, g));
+  }
+  return tasks;
+}
+
+
+// Checks the outputs of the parallel conversions in `make_tasks()` against
+// those of the serial ones.
+static void check_conversions(const input_data& data, const run_context& ctx,
+                              int t) {
+  std::vector<executor*> executors;
+  if (ctx.executors != "pool") executors.push_back(ctx.omp);
+  if (ctx.executors != "omp") executors.push_back(ctx.pool);
+  int mismatches =
+      check_parallel_conversion<bitmask_to_sentinel_simd>(data, executors, t,
+                                                          ctx.grain) +
+      check_parallel_conversion<sentinel_to_bitmask_simd>(data, executors, t,
+                                                          ctx.grain);
+  if (mismatches) {
+    printf("Parallel conversions vs serial: %d mismatches\n\n", mismatches);
+  } else {
+    printf("Parallel conversions vs serial: ok\n\n");
+  }
+}
+
+
+// Runs the reference tasks and stores the peak bandwidth into `ctx`.
+static void measure_peak_bandwidth(const input_data& data, run_context& ctx,
+                                   int t) {
+  std::cout << "Reference bandwidth:\n";
+  double n = static_cast<double>(data.n);
+  read_data ref0;                double t0 = ref0.run(data, ctx);
+  read_data_namask ref1;         double t1 = ref1.run(data, ctx);
+  read_data_omp ref2(t);         double t2 = ref2.run(data, ctx);
+  read_data_namask_omp ref3(t);  double t3 = ref3.run(data, ctx);
+  read_data_chunked ref4(*ctx.pool, t, ctx.grain);
+  double t4 = ref4.run(data, ctx);
+  ctx.peak_bandwidth1 = std::max(n * ref0.bytes_per_element() / t0,
+                                 n * ref1.bytes_per_element() / t1);
+  ctx.peak_bandwidthN = std::max(n * ref2.bytes_per_element() / t2,
+                                 n * ref3.bytes_per_element() / t3);
+  ctx.peak_bandwidthN = std::max(ctx.peak_bandwidthN,
+                                 n * ref4.bytes_per_element() / t4);
+  ctx.peak_bandwidthN = std::max(ctx.peak_bandwidthN, ctx.peak_bandwidth1);
+  printf("  peak: %.2f GB/s single-threaded, %.2f GB/s with %d threads\n\n",
+         ctx.peak_bandwidth1 * 1e-9, ctx.peak_bandwidthN * 1e-9, t);
+}
+
+
+// Results of helper computations are stored here so that the compiler cannot
+// optimize the computations away.
+static volatile int64_t total_sink;
+
+
+// Per-node read bandwidth: all threads scan their static share of `data`
+// simultaneously, and the bandwidth of each thread is attributed to the NUMA
+// node of the CPU it ran on. Additionally, a sample of the pages of `data` is
+// queried (via `move_pages`) for the node on which they actually reside.
+static void report_numa_bandwidth(const input_data& data,
+                                  const cpu_topology& topo, int nthreads) {
+  const size_t n = data.n;
+  const T* x = data.data.data();
+  std::vector<double> node_bandwidth(topo.n_nodes, 0.0);
+  std::vector<int> node_threads(topo.n_nodes, 0);
+  std::vector<double> node_pages(topo.n_nodes, 0.0);
+  int64_t sink = 0;
+  for (int iter = 0; iter < 10; ++iter) {
+    #pragma omp parallel num_threads(nthreads) reduction(+:sink)
+    {
+      size_t nth = static_cast<size_t>(omp_get_num_threads());
+      size_t ith = static_cast<size_t>(omp_get_thread_num());
+      size_t i0 = n * ith / nth;
+      size_t i1 = n * (ith + 1) / nth;
+      #pragma omp barrier
+      auto time0 = std::chrono::high_resolution_clock::now();
+      int64_t subtotal = 0;
+      for (size_t i = i0; i < i1; ++i) {
+        subtotal += x[i];
+      }
+      auto time1 = std::chrono::high_resolution_clock::now();
+      std::chrono::duration<double> diff = time1 - time0;
+      sink += subtotal;
+      int node = 0;
+      #ifdef __linux__
+        node = topo.node(sched_getcpu());
+      #endif
+      #pragma omp critical
+      {
+        node_bandwidth[node] += (i1 - i0) * sizeof(T) / diff.count() / 10;
+        if (iter == 0) node_threads[node]++;
+      }
+    }
+  }
+  #ifdef __linux__
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t npages = (n * sizeof(T) + page - 1) / page;
+    const size_t nsample = std::min(npages, size_t(4096));
+    std::vector<void*> pages(nsample);
+    std::vector<int> status(nsample, -1);
+    for (size_t i = 0; i < nsample; ++i) {
+      pages[i] = const_cast<char*>(reinterpret_cast<const char*>(x)) +
+                 (npages * i / nsample) * page;
+    }
+    long ret = syscall(__NR_move_pages, 0, nsample, pages.data(), nullptr,
+                       status.data(), 0);
+    if (ret == 0) {
+      for (int st : status) {
+        if (st >= 0 && st < topo.n_nodes) node_pages[st] += 100.0 / nsample;
+      }
+    }
+  #endif
+  total_sink = sink;
+  std::cout << "NUMA placement (static split, as in the *_omp2 tasks):\n";
+  for (int node = 0; node < topo.n_nodes; ++node) {
+    printf("  node %d: %3d threads, %7.2f GB/s, %5.1f%% of pages\n",
+           node, node_threads[node], node_bandwidth[node] * 1e-9,
+           node_pages[node]);
+  }
+  std::cout << '\n';
+}
+
+
+// Cost of dispatching an empty job (one chunk per thread) to each executor.
+static void report_dispatch_overhead(run_context& ctx, int nthreads) {
+  std::cout << "Executor dispatch overhead:\n";
+  executor* executors[] = {ctx.omp, ctx.pool};
+  for (executor* ex : executors) {
+    const int njobs = 10000;
+    int64_t sink = 0;
+    auto time0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < njobs; ++i) {
+      sink += ex->parallel_reduce(nthreads, 64 * nthreads, 64,
+                                  [](size_t i0, size_t) {
+                                    return static_cast<int64_t>(i0);
+                                  });
+    }
+    double elapsed = executor::seconds_since(time0);
+    total_sink = sink;
+    printf("  %-12s %.2f us/job\n", ex->name, elapsed / njobs * 1e6);
+    ex->stats.clear();
+  }
+  std::cout << '\n';
+}
+
+
+template <bool Bitmask, bool Simd>
+static void add_aggregate_tasks(std::vector<std::unique_ptr<task>>& tasks) {
+  tasks.emplace_back(new aggregate_task<Bitmask, agg_sum, Simd>);
+  tasks.emplace_back(new aggregate_task<Bitmask, agg_count, Simd>);
+  tasks.emplace_back(new aggregate_task<Bitmask, agg_min, Simd>);
+  tasks.emplace_back(new aggregate_task<Bitmask, agg_max, Simd>);
+  tasks.emplace_back(new aggregate_task<Bitmask, agg_sumsq, Simd>);
+  tasks.emplace_back(new aggregate_task<Bitmask, agg_all, Simd>);
+}
+
+template <bool Bitmask>
+static void add_parallel_aggregate_tasks(std::vector<std::unique_ptr<task>>& tasks,
+                                         executor& ex, int t, size_t g) {
+  tasks.emplace_back(new parallel_aggregate<Bitmask, agg_sum>(ex, t, g));
+  tasks.emplace_back(new parallel_aggregate<Bitmask, agg_count>(ex, t, g));
+  tasks.emplace_back(new parallel_aggregate<Bitmask, agg_min>(ex, t, g));
+  tasks.emplace_back(new parallel_aggregate<Bitmask, agg_max>(ex, t, g));
+  tasks.emplace_back(new parallel_aggregate<Bitmask, agg_sumsq>(ex, t, g));
+  tasks.emplace_back(new parallel_aggregate<Bitmask, agg_all>(ex, t, g));
+}
+
+
+// Result of the last run of a fused aggregate task, or null if `tsk` is not
+// one.
+template <bool Bitmask>
+static const aggregates* fused_result(const task* tsk) {
+  typedef aggregate_task<Bitmask, agg_all, false> scalar_task;
+  typedef aggregate_task<Bitmask, agg_all, true> simd_task;
+  typedef parallel_aggregate<Bitmask, agg_all> pool_task;
+  if (auto p = dynamic_cast<const scalar_task*>(tsk)) return &p->result;
+  if (auto p = dynamic_cast<const simd_task*>(tsk)) return &p->result;
+  if (auto p = dynamic_cast<const pool_task*>(tsk)) return &p->result;
+  return nullptr;
+}
+
+
+// Compares the fused SIMD kernel with the scalar one on the first 1 to 64
+// rows of the input (every length of the scalar tail, with either nibble of
+// the last bitmap byte), and on the whole input. Returns the number of
+// mismatching lengths.
+template <bool Bitmask>
+static int check_aggregate_simd(const input_data& data) {
+  std::vector<size_t> lengths;
+  for (size_t len = 1; len <= std::min<size_t>(64, data.n); ++len) {
+    lengths.push_back(len);
+  }
+  lengths.push_back(data.n);
+  int mismatches = 0;
+  for (size_t len : lengths) {
+    aggregates ref, agg;
+    aggregate_scalar<Bitmask, agg_all>(data.data.data(), data.namask.data(),
+                                       len, ref);
+    aggregate_simd<Bitmask, agg_all>(data.data.data(), data.namask.data(),
+                                     len, agg);
+    mismatches += !agg.matches(ref);
+  }
+  return mismatches;
+}
+
+
+// For each NA encoding, and for the scalar, SIMD and parallel (pool) kernels,
+// compares the time of computing the five aggregates in five separate passes
+// with the time of the fused single-pass kernel. The results of the fused
+// kernels are checked against the scalar kernel.
+static void run_aggregates(const input_data& data, run_context& ctx, int t) {
+  int mismatches = check_aggregate_simd<false>(data) +
+                   check_aggregate_simd<true>(data);
+  printf("SIMD kernels vs scalar on 1..64 rows and on all rows: %s\n",
+         mismatches? (std::to_string(mismatches) + " mismatches").c_str()
+                   : "ok");
+  aggregates sentinel_ref, bitmask_ref;
+  aggregate_scalar<false, agg_all>(data.data.data(), data.namask.data(),
+                                   data.n, sentinel_ref);
+  aggregate_scalar<true, agg_all>(data.data.data(), data.namask.data(),
+                                  data.n, bitmask_ref);
+
+  struct variant {
+    const char* name;
+    std::vector<std::unique_ptr<task>> tasks;  // five individual, then fused
+  };
+  std::vector<variant> variants(6);
+  variants[0].name = "sentinel, scalar";
+  add_aggregate_tasks<false, false>(variants[0].tasks);
+  variants[1].name = "sentinel, simd";
+  add_aggregate_tasks<false, true>(variants[1].tasks);
+  variants[2].name = "sentinel, pool";
+  add_parallel_aggregate_tasks<false>(variants[2].tasks, *ctx.pool, t, ctx.grain);
+  variants[3].name = "bitmask, scalar";
+  add_aggregate_tasks<true, false>(variants[3].tasks);
+  variants[4].name = "bitmask, simd";
+  add_aggregate_tasks<true, true>(variants[4].tasks);
+  variants[5].name = "bitmask, pool";
+  add_parallel_aggregate_tasks<true>(variants[5].tasks, *ctx.pool, t, ctx.grain);
+
+  printf("Time per run, ms:\n");
+  printf("%-18s %8s %8s %8s %8s %8s %9s %8s %8s\n", "", "sum", "count",
+         "min", "max", "sumsq", "5 passes", "fused", "speedup");
+  for (const variant& var : variants) {
+    printf("%-18s", var.name);
+    double separate = 0.0;
+    for (size_t i = 0; i + 1 < var.tasks.size(); ++i) {
+      double time = var.tasks[i]->measure(data, ctx, nullptr);
+      separate += time;
+      printf(" %8.4f", time * 1e3);
+    }
+    const task* fused_task = var.tasks.back().get();
+    double fused = var.tasks.back()->measure(data, ctx, nullptr);
+    const aggregates* result = fused_result<false>(fused_task);
+    bool ok = result? result->matches(sentinel_ref) :
+              fused_result<true>(fused_task)->matches(bitmask_ref);
+    printf(" %9.4f %8.4f %7.2fx%s\n", separate * 1e3, fused * 1e3,
+           separate / fused, ok? "" : "  WRONG");
+  }
+}
+
+
+// Filter-and-sum pipelines (`SELECT sum(y) WHERE x >= 50`, about half of the
+// valid rows), for both NA encodings, serially and morsel-driven on the pool,
+// over a range of morsel sizes plus `--morsel`. The "full" column is the
+// materialized plan: one morsel per run for the serial pipelines, and one per
+// thread for the parallel ones. The `y` column is generated like the input
+// column, with the next seed.
+static void run_pipelines(const input_data& data, const config& cfg,
+                          run_context& ctx, int t) {
+  constexpr T threshold = 50;
+  input_data y(data.n);
+  y.alloc = cfg.allocation();
+  y.na_pattern = cfg.na_pattern;
+  y.na_run = cfg.na_run;
+  y.value_run = cfg.value_run;
+  y.generate(cfg.seed + 1);
+  y.fill_nas(cfg.p, cfg.seed + 1);
+
+  std::vector<size_t> morsels = {1024, 4096, 16384, 65536, 262144};
+  if (std::find(morsels.begin(), morsels.end(), cfg.morsel) == morsels.end()) {
+    morsels.push_back(cfg.morsel);
+    std::sort(morsels.begin(), morsels.end());
+  }
+  // rounded up to a multiple of 64 rows, as the chunks must be
+  const size_t per_thread =
+      std::max<size_t>(64, ((data.n + t - 1) / t + 63) / 64 * 64);
+
+  cache_info caches;
+  printf("Detected caches: L1d = %zuK, L2 = %zuK, L3 = %zuK\n",
+         caches.l1d >> 10, caches.l2 >> 10, caches.l3 >> 10);
+  printf("Time per run, ms:\n");
+  printf("%-18s", "morsel");
+  for (size_t m : morsels) printf(" %9zu", m);
+  printf(" %9s\n", "full");
+  printf("%-18s", "working set, KB");
+  for (size_t m : morsels) {
+    printf(" %9.1f", (m * (2 * sizeof(T) + sizeof(uint32_t)) + m / 4) / 1024.0);
+  }
+  printf(" %9s\n", "-");
+
+  for (int parallel = 0; parallel < 2; ++parallel) {
+    for (int bitmask = 0; bitmask < 2; ++bitmask) {
+      printf("%-18s", (std::string(bitmask? "bitmask" : "sentinel") +
+                       (parallel? ", pool" : ", serial")).c_str());
+      std::vector<size_t> sizes = morsels;
+      sizes.push_back(parallel? per_thread : 0);
+      for (size_t m : sizes) {
+        std::unique_ptr<task> tsk;
+        if (parallel && bitmask) {
+          tsk.reset(new parallel_pipeline_task<true>(*ctx.pool, t, y, m, threshold));
+        } else if (parallel) {
+          tsk.reset(new parallel_pipeline_task<false>(*ctx.pool, t, y, m, threshold));
+        } else if (bitmask) {
+          tsk.reset(new pipeline_task<true>(y, m, threshold));
+        } else {
+          tsk.reset(new pipeline_task<false>(y, m, threshold));
+        }
+        printf(" %9.4f", tsk->measure(data, ctx, nullptr) * 1e3);
+      }
+      printf("\n");
+    }
+  }
+}
+
+
+// Filtered sums (see "Filtered aggregation") for selectivities from 0.01% to
+// 100%, printing the timings of each strategy and the winner. The filter
+// column holds uniform values in [0, 2^20), generated with the next seed.
+static void run_filtered(const input_data& data, const config& cfg,
+                         run_context& ctx) {
+  constexpr T filter_range = 1 << 20;
+  std::vector<T> filter(data.n);
+  std::mt19937 rng(cfg.seed + 1);
+  std::uniform_int_distribution<T> dist(0, filter_range - 1);
+  std::generate(filter.begin(), filter.end(), [&]() { return dist(rng); });
+
+  const double selectivities[] = {0.0001, 0.001, 0.01, 0.05, 0.1, 0.25, 0.5,
+                                  0.75, 1.0};
+  printf("Time per run, ms:\n");
+  printf("%-12s %14s %14s %14s %14s  %s\n", "selectivity", "sentinel sel",
+         "bitmask sel", "bitmap and", "compare", "winner");
+  for (double sel : selectivities) {
+    T threshold = static_cast<T>(std::llround(sel * filter_range));
+    std::vector<std::unique_ptr<task>> tasks;
+    tasks.emplace_back(new filtered_sum_selection<false>(filter, threshold));
+    tasks.emplace_back(new filtered_sum_selection<true>(filter, threshold));
+    tasks.emplace_back(new filtered_sum_bitmap(filter, threshold));
+    tasks.emplace_back(new filtered_sum_compare(filter, threshold));
+    printf("%11.2f%%", sel * 100);
+    size_t best = 0;
+    std::vector<double> times;
+    for (auto& tsk : tasks) {
+      times.push_back(tsk->measure(data, ctx, nullptr));
+      if (times.back() < times[best]) best = times.size() - 1;
+      printf(" %14.4f", times.back() * 1e3);
+    }
+    printf("  %s\n", tasks[best]->task_name.c_str());
+  }
+}
+
+
+// Autotuner for the generated kernels: for each NA policy, every combination
+// of unroll factor and accumulator count is measured (printed as a grid, in
+// ms per run), and the fastest is compared with the closest hand-written
+// method.
+static void run_autotune(const input_data& data, run_context& ctx) {
+  struct family {
+    const char* policy;
+    std::unique_ptr<task> reference;
+    std::vector<std::unique_ptr<task>> tasks;
+  };
+  std::vector<family> families(6);
+  families[0].reference.reset(new sum_ignore_nulls_batched);
+  add_generated_tasks<na_ignore>(families[0].tasks);
+  families[1].reference.reset(new sum_sentinel_nulls_if);
+  add_generated_tasks<na_sentinel_if>(families[1].tasks);
+  families[2].reference.reset(new sum_sentinel_nulls_batched);
+  add_generated_tasks<na_sentinel_mul>(families[2].tasks);
+  families[3].reference.reset(new sum_sentinel_nulls_mul);
+  add_generated_tasks<na_sentinel_blend>(families[3].tasks);
+  families[4].reference.reset(new sum_bitmask_nulls_batched);
+  add_generated_tasks<na_bitmask_mul>(families[4].tasks);
+  families[5].reference.reset(new sum_bitmask_nulls_shortcut);
+  add_generated_tasks<na_bitmask_shortcut>(families[5].tasks);
+  families[0].policy = na_ignore::name();
+  families[1].policy = na_sentinel_if::name();
+  families[2].policy = na_sentinel_mul::name();
+  families[3].policy = na_sentinel_blend::name();
+  families[4].policy = na_bitmask_mul::name();
+  families[5].policy = na_bitmask_shortcut::name();
+
+  const int accumulators[] = {1, 2, 4, 8};
+  std::vector<std::string> best_names;
+  std::vector<double> best_times, reference_times;
+  for (const family& fam : families) {
+    double reference = fam.reference->measure(data, ctx, nullptr);
+    printf("%s (hand-written %s: %.4f ms), ms per run:\n", fam.policy,
+           fam.reference->task_name.c_str(), reference * 1e3);
+    printf("  %6s", "unroll");
+    for (int a : accumulators) printf(" %8s", ("a=" + std::to_string(a)).c_str());
+    printf("\n");
+    size_t k = 0, best = 0;
+    double best_time = 0.0;
+    for (int u = 1; u <= 32; u *= 2) {
+      printf("  %6d", u);
+      for (int a : accumulators) {
+        if (a > u) {
+          printf(" %8s", "-");
+          continue;
+        }
+        double time = fam.tasks[k]->measure(data, ctx, nullptr);
+        if (k == 0 || time < best_time) {
+          best = k;
+          best_time = time;
+        }
+        printf(" %8.4f", time * 1e3);
+        ++k;
+      }
+      printf("\n");
+    }
+    best_names.push_back(fam.tasks[best]->task_name);
+    best_times.push_back(best_time);
+    reference_times.push_back(reference);
+  }
+
+  printf("\nBest configuration per policy:\n");
+  for (size_t i = 0; i < families.size(); ++i) {
+    printf("  %-18s %-30s %8.4f ms (%.2fx the hand-written method)\n",
+           families[i].policy, best_names[i].c_str(), best_times[i] * 1e3,
+           reference_times[i] / best_times[i]);
+  }
+}
+
+
+// Accumulator variants of each serial method (see `add_accumulator_tasks`),
+// in ms per run. The hand-written kernels all add into `task::total`, through
+// a reference, which makes every addition a dependency on the previous one.
+// The last columns split the gap between each method and `sum_ignore_nulls`:
+// as measured with the hand-written kernels, as measured with the fastest
+// variant of both, and the share of the former that disappears with local
+// accumulators, i.e. that was due to accumulator latency rather than to the
+// NA handling.
+static void run_accumulators(const input_data& data, run_context& ctx) {
+  struct method {
+    std::unique_ptr<task> hand;
+    std::vector<std::unique_ptr<task>> variants;
+  };
+  std::vector<method> methods(8);
+  methods[0].hand.reset(new sum_ignore_nulls);
+  add_accumulator_tasks<na_ignore, 1>(methods[0].variants);
+  methods[1].hand.reset(new sum_ignore_nulls_batched);
+  add_accumulator_tasks<na_ignore, 8>(methods[1].variants);
+  methods[2].hand.reset(new sum_sentinel_nulls_if);
+  add_accumulator_tasks<na_sentinel_if, 1>(methods[2].variants);
+  methods[3].hand.reset(new sum_sentinel_nulls_mul);
+  add_accumulator_tasks<na_sentinel_mul, 1>(methods[3].variants);
+  methods[4].hand.reset(new sum_sentinel_nulls_batched);
+  add_accumulator_tasks<na_sentinel_mul, 8>(methods[4].variants);
+  methods[5].hand.reset(new sum_bitmask_nulls);
+  add_accumulator_tasks<na_bitmask_mul, 1>(methods[5].variants);
+  methods[6].hand.reset(new sum_bitmask_nulls_batched);
+  add_accumulator_tasks<na_bitmask_mul, 8>(methods[6].variants);
+  methods[7].hand.reset(new sum_bitmask_nulls_shortcut);
+  add_accumulator_tasks<na_bitmask_shortcut, 8>(methods[7].variants);
+
+  printf("Time per run, ms:\n");
+  printf("%-28s %8s %8s %8s %8s %8s %8s %9s %9s %8s\n", "", "total", "a=1",
+         "a=2", "a=4", "a=8", "lanes32", "gap", "best gap", "latency");
+  double base_hand = 0.0, base_best = 0.0;
+  for (size_t m = 0; m < methods.size(); ++m) {
+    double hand = methods[m].hand->measure(data, ctx, nullptr);
+    double best = hand;
+    printf("%-28s %8.4f", methods[m].hand->task_name.c_str(), hand * 1e3);
+    for (auto& tsk : methods[m].variants) {
+      double time = tsk->measure(data, ctx, nullptr);
+      lanes_task* lanes = dynamic_cast<lanes_task*>(tsk.get());
+      if (lanes && lanes->period == 0) {
+        printf(" %8s", "-");  // no safe period: ran the 64-bit kernel
+        continue;
+      }
+      best = std::min(best, time);
+      printf(" %8.4f", time * 1e3);
+    }
+    if (m == 0) {
+      base_hand = hand;
+      base_best = best;
+      printf("\n");
+      continue;
+    }
+    double gap = hand - base_hand;
+    double best_gap = best - base_best;
+    printf(" %9.4f %9.4f", gap * 1e3, best_gap * 1e3);
+    if (gap > 0) {
+      double share = std::max(0.0, std::min(gap, gap - best_gap)) / gap;
+      printf(" %7.0f%%\n", 100.0 * share);
+    } else {
+      printf(" %8s\n", "-");
+    }
+  }
+}
+
+
+// Thread-scaling curves: every parallel task is run with 1, 2, 4, ... threads
+// up to `max_threads` (which is always included), reporting the speedup over
+// the single-threaded run and the parallel efficiency. The "knee" is the last
+// thread count after which doubling the threads gains less than 20% more
+// throughput -- typically the point where memory bandwidth saturates.
+static void run_scaling(const input_data& data, run_context& ctx,
+                        int max_threads) {
+  std::vector<int> counts;
+  for (int k = 1; k < max_threads; k *= 2) counts.push_back(k);
+  counts.push_back(max_threads);
+
+  for (auto& tsk : make_tasks(max_threads, ctx)) {
+    parallel_task* ptask = dynamic_cast<parallel_task*>(tsk.get());
+    if (!ptask) continue;
+    printf("%s:\n", ptask->task_name.c_str());
+    printf("  %7s %12s %8s %10s %8s\n",
+           "threads", "time, s", "speedup", "efficiency", "GB/s");
+    std::vector<double> speedups;
+    double time1 = 0.0;
+    for (int k : counts) {
+      ptask->nthreads = k;
+      double time = ptask->measure(data, ctx, nullptr);
+      if (k == 1) time1 = time;
+      double speedup = time1 / time;
+      double bandwidth = ptask->bytes_per_element() * data.n / time;
+      speedups.push_back(speedup);
+      printf("  %7d %12.6g %8.2f %9.0f%% %8.2f\n",
+             k, time, speedup, 100.0 * speedup / k, bandwidth * 1e-9);
+    }
+    size_t knee = counts.size() - 1;
+    for (size_t i = 0; i + 1 < counts.size(); ++i) {
+      double gain = speedups[i + 1] / speedups[i];
+      double ratio = static_cast<double>(counts[i + 1]) / counts[i];
+      // normalize the gain of the last (possibly non-doubling) step
+      if (std::pow(gain, std::log(2.0) / std::log(ratio)) < 1.2) {
+        knee = i;
+        break;
+      }
+    }
+    if (knee + 1 < counts.size()) {
+      printf("  knee: at %d thread(s), speedup %.2f\n\n",
+             counts[knee], speedups[knee]);
+    } else {
+      printf("  knee: not reached\n\n");
+    }
+  }
+}
+
+
+// Cost of the reduction strategies at small, morsel-sized inputs. Each timed
+// sample repeats the task until ~1M elements are processed, and the result
+// is reported as the time of a single run; the cost of the reduction itself
+// is then reported as the difference from `reduce_none`. For `reduce_pool`
+// this difference also includes the cost of dispatching a job to the pool
+// rather than entering an OMP parallel region.
+static void run_reductions(const config& cfg, run_context& ctx) {
+  int t = cfg.nthreads;
+  std::vector<std::unique_ptr<task>> tasks;
+  tasks.emplace_back(new reduce_none(t));
+  tasks.emplace_back(new reduce_atomic(t));
+  tasks.emplace_back(new reduce_omp(t));
+  tasks.emplace_back(new reduce_slots<false>(t));
+  tasks.emplace_back(new reduce_slots<true>(t));
+  tasks.emplace_back(new reduce_tree(t));
+  tasks.emplace_back(new reduce_pool(*ctx.pool, t));
+  tasks.emplace_back(new sum_sentinel_nulls_mul);
+
+  std::vector<size_t> sizes = {1024, 4096, 16384, 65536, 262144};
+  std::vector<std::unique_ptr<input_data>> inputs;
+  for (size_t n : sizes) {
+    inputs.emplace_back(new input_data(n));
+    inputs.back()->alloc = cfg.allocation();
+    inputs.back()->generate(cfg.seed);
+    inputs.back()->fill_nas(cfg.p, cfg.seed);
+  }
+  // The first of the timed tasks is the baseline, so warm up (threads,
+  // caches, branch predictors) with an untimed run of every task first.
+  for (auto& tsk : tasks) {
+    for (auto& data : inputs) tsk->run_once(*data);
+  }
+  std::vector<std::vector<double>> times(tasks.size());
+  for (size_t k = 0; k < tasks.size(); ++k) {
+    for (auto& data : inputs) {
+      ctx.reps = static_cast<int>(std::max(size_t(1), (size_t(1) << 20) / data->n));
+      times[k].push_back(tasks[k]->measure(*data, ctx, nullptr));
+    }
+  }
+  ctx.reps = 1;
+
+  printf("Time per run, us:\n");
+  printf("%-30s", "n =");
+  for (size_t n : sizes) printf(" %9zu", n);
+  printf("\n");
+  for (size_t k = 0; k < tasks.size(); ++k) {
+    printf("%-30s", tasks[k]->task_name.c_str());
+    for (double time : times[k]) printf(" %9.3f", time * 1e6);
+    printf("\n");
+  }
+  printf("\nCost of the reduction (minus reduce_none), us:\n");
+  for (size_t k = 1; k < tasks.size(); ++k) {
+    if (!dynamic_cast<parallel_task*>(tasks[k].get())) continue;
+    printf("%-30s", tasks[k]->task_name.c_str());
+    for (size_t j = 0; j < sizes.size(); ++j) {
+      printf(" %9.3f", (times[k][j] - times[0][j]) * 1e6);
+    }
+    printf("\n");
+  }
+}
+
+
+// Runs all tasks with the input allocated in each of the `--alloc` modes, and
+// prints the timings side by side.
+static void run_alloc_compare(const config& cfg, run_context& ctx) {
+  const char* modes[] = {"malloc", "aligned", "thp", "hugetlb"};
+  auto tasks = make_tasks(cfg.nthreads, ctx);
+  std::vector<std::vector<double>> times(tasks.size());
+  for (const char* mode : modes) {
+    input_data data(cfg.n);
+    data.alloc = cfg.allocation();
+    data.alloc.mode = mode;
+    data.na_pattern = cfg.na_pattern;
+    data.na_run = cfg.na_run;
+    data.value_run = cfg.value_run;
+    if (cfg.first_touch) data.first_touch_threads = cfg.nthreads;
+    data.generate(cfg.seed);
+    data.fill_nas(cfg.p, cfg.seed);
+    printf("alloc = %-8s data at %p, namask at %p%s\n", mode,
+           static_cast<void*>(data.data.data()),
+           static_cast<void*>(data.namask.data()),
+           data.alloc.mode == "hugetlb" && !data.data.mapped?
+             " (no huge pages reserved, fell back to thp)" : "");
+    for (size_t i = 0; i < tasks.size(); ++i) {
+      times[i].push_back(tasks[i]->measure(data, ctx, nullptr));
+    }
+  }
+  printf("\nTime per run, ms:\n");
+  printf("%-30s", "");
+  for (const char* mode : modes) printf(" %9s", mode);
+  printf("\n");
+  for (size_t i = 0; i < tasks.size(); ++i) {
+    printf("%-30s", tasks[i]->task_name.c_str());
+    for (double time : times[i]) printf(" %9.4f", time * 1e3);
+    printf("\n");
+  }
+}
+
+
+// Compares the throughput of scanning a column file batch by batch (see
+// `column_stream`) against scanning the same file entirely mapped in memory.
+static void run_streaming(const config& cfg, run_context& ctx) {
+  column_stream stream(cfg.stream, cfg.batch);
+  input_data mapped(0);
+  mapped.map_column(cfg.stream, true, "sequential");
+  printf("Streaming %s: n = %zu, batch = %zu rows\n\n",
+         cfg.stream.c_str(), stream.n(), stream.batch);
+
+  std::vector<std::unique_ptr<task>> tasks;
+  tasks.emplace_back(new sum_ignore_nulls_batched);
+  tasks.emplace_back(new sum_sentinel_nulls_mul);
+  tasks.emplace_back(new sum_sentinel_nulls_batched);
+  tasks.emplace_back(new sum_bitmask_nulls_batched);
+  tasks.emplace_back(new sum_bitmask_nulls_shortcut);
+
+  printf("%-30s %12s %12s %8s\n", "Gelem/s", "in-memory", "streamed", "ratio");
+  const int passes = 5;
+  for (auto& tsk : tasks) {
+    double in_memory = mapped.n / tsk->measure(mapped, ctx, nullptr);
+    // Only the bitmask methods read more than the values themselves.
+    bool with_bitmap = tsk->bytes_per_element() > sizeof(T);
+    double elapsed = 0.0;
+    for (int i = 0; i < passes; ++i) {
+      elapsed += stream.run(*tsk, with_bitmap);
+    }
+    double streamed = stream.n() * passes / elapsed;
+    printf("%-30s %12.3f %12.3f %7.0f%%\n", tsk->task_name.c_str(),
+           in_memory * 1e-9, streamed * 1e-9, 100.0 * streamed / in_memory);
+  }
+}
+
+
+// For each of a range of NA fractions, measures the best serial method of
+// each NA encoding (sentinel, bitmask, sparse list of positions), and reports
+// which encoding wins, together with the extra memory each one needs.
+static void run_crossover(const config& cfg, run_context& ctx) {
+  const double ps[] = {0, 1e-5, 1e-4, 1e-3, 3e-3, 1e-2, 3e-2, 0.1, 0.5};
+  struct encoding {
+    const char* name;
+    std::vector<std::unique_ptr<task>> tasks;
+  };
+  std::vector<encoding> encodings(3);
+  encodings[0].name = "sentinel";
+  encodings[0].tasks.emplace_back(new sum_sentinel_nulls_mul);
+  encodings[0].tasks.emplace_back(new sum_sentinel_nulls_batched);
+  encodings[1].name = "bitmask";
+  encodings[1].tasks.emplace_back(new sum_bitmask_nulls_batched);
+  encodings[1].tasks.emplace_back(new sum_bitmask_nulls_shortcut);
+  encodings[2].name = "sparse";
+  encodings[2].tasks.emplace_back(new sum_sparse_nulls<uint32_t>);
+  encodings[2].tasks.emplace_back(new sum_sparse_nulls<uint64_t>);
+
+  printf("Time per run (ms) of the best method of each encoding, and the "
+         "extra bytes\nper element each encoding stores:\n");
+  printf("%-9s", "p");
+  for (const encoding& enc : encodings) printf(" %9s", enc.name);
+  printf(" %9s %9s %9s  winner\n", "+sentinel", "+bitmask", "+sparse");
+  for (double p : ps) {
+    input_data data(cfg.n);
+    data.alloc = cfg.allocation();
+    data.na_pattern = cfg.na_pattern;
+    data.na_run = cfg.na_run;
+    data.value_run = cfg.value_run;
+    if (cfg.first_touch) data.first_touch_threads = cfg.nthreads;
+    data.generate(cfg.seed);
+    data.fill_nas(p, cfg.seed);
+    printf("%-9g", p);
+    double best_time = 0;
+    const char* winner = "";
+    for (const encoding& enc : encodings) {
+      double time = 0;
+      for (const auto& tsk : enc.tasks) {
+        double t = tsk->measure(data, ctx, nullptr);
+        if (time == 0 || t < time) time = t;
+      }
+      printf(" %9.4f", time * 1e3);
+      if (best_time == 0 || time < best_time) {
+        best_time = time;
+        winner = enc.name;
+      }
+    }
+    const sparse_nas& nas = data.sparse();
+    double n = std::max(1.0, static_cast<double>(cfg.n));
+    double sparse_bytes = static_cast<double>(nas.count()) *
+                          (nas.positions<uint32_t>()? 4 : 8);
+    printf(" %9.4f %9.4f %9.4f  %s\n", 0.0, 0.125, sparse_bytes / n, winner);
+  }
+}
+
+
+// Measures the roaring-style encoding against the bitmask and the sentinel
+// methods under several distributions of the NAs (at the configured `p`),
+// and reports the compressed size and the container mix for each of them.
+static void run_roaring_compare(const config& cfg, run_context& ctx) {
+  struct pattern { const char* label; const char* name; double run; };
+  const pattern patterns[] = {
+    {"uniform", "uniform", 0},
+    {"run=16", "clustered", 16},
+    {"run=256", "clustered", 256},
+    {"run=4K", "clustered", 4096},
+    {"run=64K", "clustered", 65536},
+  };
+  std::vector<std::unique_ptr<task>> tasks;
+  tasks.emplace_back(new sum_sentinel_nulls_batched);
+  tasks.emplace_back(new sum_bitmask_nulls_shortcut);
+  tasks.emplace_back(new sum_roaring_nulls);
+  tasks.emplace_back(new count_bitmask_nulls);
+  tasks.emplace_back(new count_roaring_nulls);
+  tasks.emplace_back(new filter_bitmask_nulls);
+  tasks.emplace_back(new filter_roaring_nulls);
+  std::vector<std::vector<double>> times(tasks.size());
+  std::vector<double> sizes;
+  std::vector<std::string> mixes;
+  for (const pattern& pat : patterns) {
+    input_data data(cfg.n);
+    data.alloc = cfg.allocation();
+    data.na_pattern = pat.name;
+    data.na_run = pat.run;
+    data.value_run = cfg.value_run;
+    if (cfg.first_touch) data.first_touch_threads = cfg.nthreads;
+    data.generate(cfg.seed);
+    data.fill_nas(cfg.p, cfg.seed);
+    for (size_t i = 0; i < tasks.size(); ++i) {
+      times[i].push_back(tasks[i]->measure(data, ctx, nullptr));
+    }
+    const roaring_nas& r = data.roaring();
+    sizes.push_back(static_cast<double>(r.storage_bytes()) /
+                    static_cast<double>(std::max<size_t>(1, cfg.n)));
+    mixes.push_back(std::to_string(r.count(roaring_nas::array)) + "/" +
+                    std::to_string(r.count(roaring_nas::bitmap)) + "/" +
+                    std::to_string(r.count(roaring_nas::run)));
+  }
+  printf("Time per run, ms:\n");
+  printf("%-30s", "");
+  for (const pattern& pat : patterns) printf(" %10s", pat.label);
+  printf("\n");
+  for (size_t i = 0; i < tasks.size(); ++i) {
+    printf("%-30s", tasks[i]->task_name.c_str());
+    for (double time : times[i]) printf(" %10.4f", time * 1e3);
+    printf("\n");
+  }
+  printf("\n%-30s", "bitmask, bytes/elem");
+  for (size_t j = 0; j < sizes.size(); ++j) printf(" %10.4f", 0.125);
+  printf("\n%-30s", "roaring, bytes/elem");
+  for (double size : sizes) printf(" %10.4f", size);
+  printf("\n%-30s", "containers array/bitmap/run");
+  for (const std::string& mix : mixes) printf(" %10s", mix.c_str());
+  printf("\n");
+}
+
+
+// Working-set sweep: every task is run on inputs sized to fit into L1, L2,
+// L3, and finally on an input 4x larger than the last-level cache. For the
+// cache-resident sizes each timed sample consists of runs over about 1M
+// elements, which rotate through up to 64 inputs of the given size with
+// independent NA patterns, so that the branch predictor cannot learn the
+// pattern of a single input. Together these inputs exceed the cache level,
+// so part of each one may be read from the next level.
+static void run_sweep(const config& cfg, run_context& ctx) {
+  cache_info caches;
+  struct level { const char* name; size_t bytes; };
+  std::vector<level> levels = {
+    {"L1", caches.l1d / 2},
+    {"L2", caches.l2 / 2},
+    {"L3", caches.l3 / 2},
+    {"DRAM", std::max(caches.l3 * 4, size_t(64) << 20)},
+  };
+  printf("Detected caches: L1d = %zuK, L2 = %zuK, L3 = %zuK\n\n",
+         caches.l1d >> 10, caches.l2 >> 10, caches.l3 >> 10);
+
+  auto tasks = make_tasks(cfg.nthreads, ctx);
+  std::vector<std::vector<double>> throughput(tasks.size());
+  for (const level& lvl : levels) {
+    // Round down to a whole number of validity bytes.
+    size_t n = static_cast<size_t>(lvl.bytes / bitmask_bytes_per_element);
+    n = std::max(n & ~size_t(7), size_t(64));
+    printf("Working set %-4s: n = %zu (%zuK)\n", lvl.name, n, lvl.bytes >> 10);
+    ctx.reps = static_cast<int>(std::max(size_t(1), (size_t(1) << 20) / n));
+    input_rotation rotation;
+    for (int k = 0; k < std::min(ctx.reps, 64); ++k) {
+      std::unique_ptr<input_data> data(new input_data(n));
+      data->alloc = cfg.allocation();
+      data->na_pattern = cfg.na_pattern;
+      data->na_run = cfg.na_run;
+      data->value_run = cfg.value_run;
+      if (cfg.first_touch) data->first_touch_threads = cfg.nthreads;
+      data->generate(cfg.seed + k);
+      data->fill_nas(cfg.p, cfg.seed + k);
+      rotation.inputs.push_back(std::move(data));
+    }
+    ctx.rotation = rotation.inputs.size() > 1? &rotation : nullptr;
+    for (size_t i = 0; i < tasks.size(); ++i) {
+      // build the encodings of every input outside of the timed region
+      for (auto& in : rotation.inputs) {
+        tasks[i]->prepare(*in);
+        tasks[i]->run_once(*in);
+      }
+      double time = tasks[i]->measure(*rotation.inputs[0], ctx, nullptr);
+      throughput[i].push_back(static_cast<double>(n) / time);
+    }
+  }
+  ctx.reps = 1;
+  ctx.rotation = nullptr;
+
+  printf("\nThroughput, Gelem/s:\n");
+  printf("%-30s", "");
+  for (const level& lvl : levels) printf(" %8s", lvl.name);
+  printf("\n");
+  for (size_t i = 0; i < tasks.size(); ++i) {
+    printf("%-30s", tasks[i]->task_name.c_str());
+    for (double tp : throughput[i]) printf(" %8.3f", tp * 1e-9);
+    printf("\n");
+  }
+}
+
+
 int main(int argc, char** argv) {
   config cfg;
-  cfg.parse(argc, argv);
+  try {
+    cfg.parse(argc, argv);
+  } catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << '\n';
+    return 1;
+  }
   cfg.report();
 
-  std::cout << "Generating data...\n";
-  input_data data(cfg.n);
-  data.generate(cfg.seed);
-  data.fill_nas(cfg.p, cfg.seed);
-  std::cout << "  done.\n\n";
+  // The counters must be opened before the OMP threads are created, so that
+  // the worker threads inherit them.
+  perf_counters counters;
+  run_context ctx;
+  if (cfg.perf) {
+    if (counters.open()) {
+      ctx.perf = &counters;
+    } else {
+      std::cout << "Hardware performance counters are not available, "
+                   "--perf ignored.\n\n";
+    }
+  }
 
+  cache_flusher flusher;
+  if (cfg.cold) ctx.flusher = &flusher;
+
+  // In scaling mode the thread pools are sized for all hardware threads.
   int t = cfg.nthreads;
+  int max_threads = cfg.scaling? std::max(t, omp_get_num_procs()) : t;
   { // warm up OMP system, in particular this allocates the thread pool
     int z = 0;
-    #pragma omp parallel for num_threads(t)
+    #pragma omp parallel for num_threads(max_threads)
     for (size_t i = 0; i < 10000; ++i) {
       z += i;
     }
   }
+  cpu_topology topo;
+  if (cfg.bind != "none") pin_omp_threads(topo, cfg.bind, max_threads);
+
+  omp_executor omp;
+  thread_pool pool(max_threads, cfg.bind == "none"? std::vector<int>()
+                                        : topo.placement(cfg.bind));
+  ctx.omp = &omp;
+  ctx.pool = &pool;
+  ctx.grain = cfg.grain;
+  ctx.executors = cfg.executors;
+
+  if (cfg.reductions) {
+    run_reductions(cfg, ctx);
+    std::cout << '\n';
+    return 0;
+  }
+
+  if (cfg.crossover) {
+    run_crossover(cfg, ctx);
+    std::cout << '\n';
+    return 0;
+  }
+
+  if (cfg.roaring) {
+    run_roaring_compare(cfg, ctx);
+    std::cout << '\n';
+    return 0;
+  }
+
+  if (cfg.sweep) {
+    run_sweep(cfg, ctx);
+    std::cout << '\n';
+    return 0;
+  }
+
+  if (!cfg.stream.empty()) {
+    try {
+      run_streaming(cfg, ctx);
+    } catch (const std::exception& e) {
+      std::cerr << "Error: " << e.what() << '\n';
+      return 1;
+    }
+    std::cout << '\n';
+    return 0;
+  }
+
+  if (cfg.alloc == "all") {
+    run_alloc_compare(cfg, ctx);
+    std::cout << '\n';
+    return 0;
+  }
+
+  input_data data(cfg.n);
+  data.pack_bits = cfg.pack_bits;
+  data.report_builds = true;
+  try {
+    if (!cfg.arrow.empty()) {
+      std::cout << "Loading " << cfg.arrow << "...\n";
+      data.alloc = cfg.allocation();
+      data.load_arrow(cfg.arrow, cfg.arrow_column);
+    } else if (cfg.read_column.empty()) {
+      std::cout << "Generating data...\n";
+      data.alloc = cfg.allocation();
+      data.na_pattern = cfg.na_pattern;
+      data.na_run = cfg.na_run;
+      data.value_run = cfg.value_run;
+      if (cfg.first_touch) data.first_touch_threads = t;
+      data.generate(cfg.seed);
+      data.fill_nas(cfg.p, cfg.seed);
+    } else {
+      std::cout << "Mapping " << cfg.read_column << "...\n";
+      data.map_column(cfg.read_column, cfg.populate, cfg.advice);
+      std::cout << "  n = " << data.n << '\n';
+    }
+    if (!cfg.write_column.empty()) {
+      data.write_column(cfg.write_column);
+      std::cout << "  written to " << cfg.write_column << '\n';
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << '\n';
+    return 1;
+  }
+  {
+    auto time0 = std::chrono::high_resolution_clock::now();
+    const column_stats& stats = data.stats();
+    auto time1 = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> diff = time1 - time0;
+    printf("  na_count = %zu (%s), computed in %g s\n", stats.na_count,
+           stats.all_na()? "all NA" : stats.all_valid()? "all valid" : "mixed",
+           diff.count());
+    time0 = std::chrono::high_resolution_clock::now();
+    const zone_map& zones = data.zones();
+    time1 = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> zones_time = time1 - time0;
+    size_t nvalid = 0, nna = 0;
+    for (const zone_map::block& blk : zones.blocks) {
+      nvalid += blk.flags == zone_map::all_valid;
+      nna += blk.flags == zone_map::all_na;
+    }
+    printf("  zone map: %zu blocks of %zu rows (%zu all valid, %zu all NA), "
+           "%zu bytes (%.2f%% of the bitmap), built in %g s\n",
+           zones.blocks.size(), zone_map::block_size, nvalid, nna,
+           zones.storage_bytes(),
+           100.0 * zones.storage_bytes() / std::max<size_t>(1, data.namask.size()),
+           zones_time.count());
+  }
+  std::cout << "  done.\n\n";
+
+  if (cfg.scaling) {
+    run_scaling(data, ctx, max_threads);
+    return 0;
+  }
+
+  if (cfg.aggregates) {
+    run_aggregates(data, ctx, t);
+    std::cout << '\n';
+    return 0;
+  }
+
+  if (cfg.pipeline) {
+    run_pipelines(data, cfg, ctx, t);
+    std::cout << '\n';
+    return 0;
+  }
+
+  if (cfg.filtered) {
+    run_filtered(data, cfg, ctx);
+    std::cout << '\n';
+    return 0;
+  }
+
+  if (cfg.autotune) {
+    run_autotune(data, ctx);
+    std::cout << '\n';
+    return 0;
+  }
+
+  if (cfg.accumulators) {
+    run_accumulators(data, ctx);
+    std::cout << '\n';
+    return 0;
+  }
+
+  measure_peak_bandwidth(data, ctx, t);
+  report_dispatch_overhead(ctx, t);
+  if (cfg.bind != "none" || cfg.first_touch) {
+    report_numa_bandwidth(data, topo, t);
+  }
 
-  sum_ignore_nulls task0;            task0.run(data);
-  sum_ignore_nulls_batched task1;    task1.run(data);
-  sum_sentinel_nulls_if task2;       task2.run(data);
-  sum_sentinel_nulls_mul task3;      task3.run(data);
-  sum_sentinel_nulls_batched task4;  task4.run(data);
-  sum_bitmask_nulls task5;           task5.run(data);
-  sum_bitmask_nulls_batched task6;   task6.run(data);
-  sum_bitmask_nulls_shortcut task7;  task7.run(data);
-  sum_sentinel_nulls_omp1 task8(t);  task8.run(data);
-  sum_sentinel_nulls_omp2 task9(t);  task9.run(data);
-  sum_bitmask_nulls_omp2 taskA(t);   taskA.run(data);
+  check_conversions(data, ctx, t);
+  for (auto& tsk : make_tasks(t, ctx)) {
+    tsk->run(data, ctx);
+  }
 
   std::cout << '\n';
   return 0;